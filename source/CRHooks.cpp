@@ -1,9 +1,18 @@
+#include <deque>
+#include <execution>
 #include <xbyak/xbyak.h>
 #include "D3DShaderReplacement.h"
 #include "DebuggingUtil.h"
 #include "CRHooks.h"
+#include "DXContainer.h"
+#include "DXGIHooks.h"
+#include "HitchMonitor.h"
+#include "LiveUpdateTracking.h"
+#include "PipelinePrewarm.h"
+#include "PipelineRetirement.h"
 #include "Plugin.h"
 #include "ReShadeHelper.h"
+#include "ShaderBinIndex.h"
 
 namespace CRHooks
 {
@@ -17,83 +26,344 @@ namespace CRHooks
 	std::vector<TrackedDataEntry> TrackedPipelineData;
 	std::unordered_map<uint64_t, CComPtr<ID3D12RootSignature>> TrackedTechniqueIdToRootSignature;
 
+	LiveUpdateTracking::PipelineIndex TrackedPipelineIndex; // Mirrors TrackedPipelineData
+
+	class DirectoryWatch
+	{
+	private:
+		HANDLE m_Directory = INVALID_HANDLE_VALUE;
+		HANDLE m_Event = nullptr;
+		OVERLAPPED m_Overlapped = {};
+		bool m_Pending = false;
+		alignas(DWORD) std::array<uint8_t, 64 * 1024> m_Buffer;
+
+	public:
+		DirectoryWatch(const DirectoryWatch&) = delete;
+		DirectoryWatch& operator=(const DirectoryWatch&) = delete;
+
+		DirectoryWatch(const std::filesystem::path& Directory)
+		{
+			m_Directory = CreateFileW(
+				Directory.c_str(),
+				FILE_LIST_DIRECTORY,
+				FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+				nullptr,
+				OPEN_EXISTING,
+				FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+				nullptr);
+
+			m_Event = CreateEventW(nullptr, true, false, nullptr);
+		}
+
+		~DirectoryWatch()
+		{
+			if (m_Pending)
+			{
+				DWORD bytesTransferred = 0;
+
+				CancelIoEx(m_Directory, &m_Overlapped);
+				GetOverlappedResult(m_Directory, &m_Overlapped, &bytesTransferred, true);
+			}
+
+			if (m_Directory != INVALID_HANDLE_VALUE)
+				CloseHandle(m_Directory);
+
+			if (m_Event)
+				CloseHandle(m_Event);
+		}
+
+		HANDLE GetEvent() const
+		{
+			return m_Event;
+		}
+
+		bool Issue()
+		{
+			if (m_Directory == INVALID_HANDLE_VALUE || !m_Event)
+				return false;
+
+			ResetEvent(m_Event);
+			m_Overlapped = {};
+			m_Overlapped.hEvent = m_Event;
+
+			m_Pending = ReadDirectoryChangesW(
+				m_Directory,
+				m_Buffer.data(),
+				static_cast<DWORD>(m_Buffer.size()),
+				true,
+				FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME,
+				nullptr,
+				&m_Overlapped,
+				nullptr);
+
+			return m_Pending;
+		}
+
+		// Returns false when the notification buffer overflowed and changes were lost
+		bool Collect(std::vector<ShaderPaths::PathTarget>& Targets)
+		{
+			DWORD bytesTransferred = 0;
+			m_Pending = false;
+
+			if (!GetOverlappedResult(m_Directory, &m_Overlapped, &bytesTransferred, false) || bytesTransferred == 0)
+				return false;
+
+			for (size_t offset = 0;;)
+			{
+				const auto info = reinterpret_cast<const FILE_NOTIFY_INFORMATION *>(m_Buffer.data() + offset);
+				const std::wstring_view relativePath(info->FileName, info->FileNameLength / sizeof(WCHAR));
+
+				if (auto target = ShaderPaths::ClassifyPath(relativePath); target.Type != ShaderPaths::PathTarget::Kind::Ignored)
+					Targets.emplace_back(std::move(target));
+
+				if (info->NextEntryOffset == 0)
+					break;
+
+				offset += info->NextEntryOffset;
+			}
+
+			return true;
+		}
+	};
+
+	struct RecompileItem
+	{
+		size_t Index = 0;
+		CreationRenderer::TechniqueData *Technique = nullptr;
+		D3DPipelineStateStream::Copy StreamCopy;
+		CComPtr<ID3D12PipelineState> PipelineState;
+		uint32_t CompileTime = 0; // Microseconds
+		uint64_t RetiredSize = 0; // Bytes
+	};
+
+	struct PendingSwap
+	{
+		CreationRenderer::TechniqueData *Technique = nullptr;
+		CComPtr<ID3D12PipelineState> PipelineState;
+		uint32_t CompileTime = 0; // Microseconds
+		uint64_t RetiredSize = 0; // Bytes
+	};
+
+	// Compiled pipelines waiting for a frame with room in the swap budget
+	std::mutex PendingSwapsLock;
+	std::deque<PendingSwap> PendingSwaps;
+
+	void SwapPipelineState(PendingSwap& Swap)
+	{
+		// The game keeps exactly 1 reference to its pipeline state. Ours is handed over to the game and the game's
+		// old reference is retired once the GPU can no longer be using it.
+		//
+		// WARNING: This'll never be thread safe. It's meant as a developer tool, not for production.
+		auto targetPointer = reinterpret_cast<void **>(&Swap.Technique->m_PipelineState);
+		auto oldValue = InterlockedExchangePointer(targetPointer, Swap.PipelineState.Detach());
+
+		PipelineRetirement::Retire(static_cast<ID3D12PipelineState *>(oldValue), Swap.RetiredSize);
+
+		HitchMonitor::RecordLiveUpdate(Swap.Technique->m_Id, Swap.Technique->m_Name, Swap.CompileTime);
+	}
+
+	void QueueSwap(PendingSwap&& Swap)
+	{
+		// Queued swaps are only applied on present. Nothing would ever apply them without the present hook.
+		if (Plugin::LiveUpdateSwapsPerFrame == 0 || !DXGIHooks::IsPresentHooked())
+		{
+			SwapPipelineState(Swap);
+			return;
+		}
+
+		std::scoped_lock lock(PendingSwapsLock);
+
+		// A newer compile of the same technique supersedes one that's still waiting
+		auto itr = std::find_if(
+			PendingSwaps.begin(),
+			PendingSwaps.end(),
+			[&](const PendingSwap& Pending)
+			{
+				return Pending.Technique == Swap.Technique;
+			});
+
+		if (itr != PendingSwaps.end())
+		{
+			// The game's pipeline is still the one that was built before the superseded compile
+			Swap.RetiredSize = itr->RetiredSize;
+			*itr = std::move(Swap);
+		}
+		else
+			PendingSwaps.emplace_back(std::move(Swap));
+	}
+
 	void LiveUpdateFilesystemWatcherThread(CComPtr<ID3D12Device2> Device)
 	{
-		const auto changeHandle = FindFirstChangeNotificationW(
-			D3DShaderReplacement::GetShaderBinDirectory().c_str(),
-			true,
-			FILE_NOTIFY_CHANGE_LAST_WRITE);
+		// One watch per shader directory layer
+		std::vector<std::unique_ptr<DirectoryWatch>> watches;
+		std::vector<HANDLE> changeEvents;
+
+		for (const auto& directory : D3DShaderReplacement::GetShaderBinDirectories())
+		{
+			auto watch = std::make_unique<DirectoryWatch>(directory);
+
+			if (!watch->Issue())
+			{
+				spdlog::error("Live update: ReadDirectoryChangesW failed with error code {:X}.", GetLastError());
+				continue;
+			}
+
+			changeEvents.emplace_back(watch->GetEvent());
+			watches.emplace_back(std::move(watch));
+		}
 
-		if (changeHandle == INVALID_HANDLE_VALUE)
+		if (watches.size() > MAXIMUM_WAIT_OBJECTS)
 		{
-			spdlog::error("Live update: FindFirstChangeNotification failed with error code {:X}.", GetLastError());
+			spdlog::error("Live update: Can't watch more than {} shader directories.", MAXIMUM_WAIT_OBJECTS);
 			return;
 		}
 
+		if (watches.empty())
+			return;
+
 		spdlog::info("Live update: Initialized.");
 
+		LiveUpdateTracking::ChangeBatcher batcher;
+
 		while (true)
 		{
-			const auto status = WaitForSingleObject(changeHandle, INFINITE);
+			// Block until something changes, then keep collecting until the burst is over
+			if (const auto now = std::chrono::steady_clock::now(); !batcher.IsReady(now))
+			{
+				const auto waitTime = batcher.GetWaitTime(now);
+				const auto timeout =
+					waitTime ? static_cast<DWORD>(std::chrono::ceil<std::chrono::milliseconds>(*waitTime).count()) : INFINITE;
+				const auto status = WaitForMultipleObjects(static_cast<DWORD>(changeEvents.size()), changeEvents.data(), false, timeout);
 
-			if (status != WAIT_OBJECT_0)
-				break;
+				if (status == WAIT_TIMEOUT)
+					continue;
+
+				if (status < WAIT_OBJECT_0 || status >= WAIT_OBJECT_0 + changeEvents.size())
+					return;
+
+				auto& watch = *watches[status - WAIT_OBJECT_0];
+				std::vector<ShaderPaths::PathTarget> targets;
+				const bool changesLost = !watch.Collect(targets);
+
+				if (!watch.Issue())
+				{
+					spdlog::error("Live update: ReadDirectoryChangesW failed with error code {:X}.", GetLastError());
+					return;
+				}
+
+				batcher.Add(targets, changesLost, std::chrono::steady_clock::now());
+				continue;
+			}
+
+			if (batcher.HasLostChanges())
+				spdlog::warn("Live update: Too many changes at once. Recreating all pipelines.");
+
+			const auto targets = batcher.Take();
+
+			if (targets.empty())
+				continue;
+
+			// Files may have been added or removed. Refresh the index before patching.
+			ShaderBinIndex::Build(D3DShaderReplacement::GetShaderBinDirectories());
+
+			// Streams are copied so that the game's pipeline threads aren't blocked while compiling
+			std::vector<RecompileItem> items;
+			size_t trackedCount = 0;
 
-			// Update all known shaders in the directory. The loop might run multiple times if multiple files are
-			// changed but that's okay.
-			TrackedShaderDataLock.lock();
 			{
-				size_t patchCounter = 0;
+				std::scoped_lock lock(TrackedShaderDataLock);
+				const auto affectedIndices = TrackedPipelineIndex.Find(targets);
 
-				for (auto& data : TrackedPipelineData)
+				trackedCount = TrackedPipelineData.size();
+				items.reserve(affectedIndices.size());
+
+				for (const auto index : affectedIndices)
 				{
+					const auto& data = TrackedPipelineData[index];
+
+					items.emplace_back(RecompileItem {
+						.Index = index,
+						.Technique = data.Technique,
+						.StreamCopy = D3DPipelineStateStream::Copy(data.StreamCopy.GetDesc()),
+					});
+				}
+			}
+
+			PipelineTelemetry::Stopwatch batchStopwatch;
+
+			std::for_each(
+				std::execution::par,
+				items.begin(),
+				items.end(),
+				[&](RecompileItem& Item)
+				{
+					// The copy still describes the game's current pipeline until it's patched
+					Item.RetiredSize = PipelineRetirement::EstimatePipelineSize(Item.StreamCopy.GetDesc());
+
 					const bool newPipelineRequired = D3DShaderReplacement::PatchPipelineStateStream(
-						data.StreamCopy,
+						Item.StreamCopy,
 						Device.Get(),
 						nullptr,
-						data.Technique->m_Name,
-						data.Technique->m_Id);
+						Item.Technique->m_Name,
+						Item.Technique->m_Id,
+						{});
 
 					if (!newPipelineRequired)
-						continue;
+						return;
+
+					PipelineTelemetry::Stopwatch stopwatch;
 
-					CComPtr<ID3D12PipelineState> pipelineState;
-					if (auto hr = Device->CreatePipelineState(data.StreamCopy.GetDesc(), IID_PPV_ARGS(&pipelineState)); FAILED(hr))
+					if (auto hr = Device->CreatePipelineState(Item.StreamCopy.GetDesc(), IID_PPV_ARGS(&Item.PipelineState)); FAILED(hr))
 					{
 						spdlog::error(
 							"Live update: Failed to compile pipeline: {:X}. Shader technique: {:X}.",
 							static_cast<uint32_t>(hr),
-							data.Technique->m_Id);
+							Item.Technique->m_Id);
 
-						continue;
+						Item.PipelineState = nullptr;
+						return;
 					}
 
-					DebuggingUtil::SetObjectDebugName(pipelineState.Get(), data.Technique->m_Name);
+					DebuggingUtil::SetObjectDebugName(Item.PipelineState.Get(), Item.Technique->m_Name);
+					Item.CompileTime = stopwatch.Lap();
+				});
 
-					// pipelineState->AddRef() is needed due to CComPtr's destructor. Luckily for us, the game keeps
-					// exactly 1 reference to the old state so we don't have to fix mismatched reference counts.
-					//
-					// WARNING: This'll never be thread safe. It's meant as a developer tool, not for production.
-					//
-					// HACK: oldValue is never released. It's not stable and leaks memory for now.
-					pipelineState->AddRef();
+			const auto batchTime = batchStopwatch.Lap();
+			size_t patchCounter = 0;
 
-					auto targetPointer = reinterpret_cast<void **>(&data.Technique->m_PipelineState);
-					auto oldValue = InterlockedExchangePointer(targetPointer, pipelineState.Get());
-					(void)oldValue; // ->Release();
+			{
+				std::scoped_lock lock(TrackedShaderDataLock);
 
-					patchCounter++;
+				for (auto& item : items)
+				{
+					if (item.PipelineState)
+						TrackedPipelineData[item.Index].StreamCopy = std::move(item.StreamCopy);
 				}
+			}
+
+			for (auto& item : items)
+			{
+				if (!item.PipelineState)
+					continue;
+
+				QueueSwap({
+					.Technique = item.Technique,
+					.PipelineState = std::move(item.PipelineState),
+					.CompileTime = item.CompileTime,
+					.RetiredSize = item.RetiredSize,
+				});
 
-				if (patchCounter > 0)
-					spdlog::info("Live update: Created pipelines for {} technique(s).", patchCounter);
+				patchCounter++;
 			}
-			TrackedShaderDataLock.unlock();
 
-			FindNextChangeNotification(changeHandle);
+			spdlog::info(
+				"Live update: {} file change(s) affected {} of {} pipeline(s). Created pipelines for {} technique(s) in {:.1f} ms.",
+				targets.size(),
+				items.size(),
+				trackedCount,
+				patchCounter,
+				batchTime / 1000.0);
 		}
-
-		FindCloseChangeNotification(changeHandle);
 	}
 
 	void TrackDevice(CComPtr<ID3D12Device2> Device)
@@ -101,8 +371,12 @@ namespace CRHooks
 		static bool once = [&]
 		{
 			if (Plugin::AllowLiveUpdates)
+			{
+				PipelineRetirement::Initialize(Device.Get());
 				std::thread(LiveUpdateFilesystemWatcherThread, Device).detach();
+			}
 
+			PipelinePrewarm::Start(Device);
 			ReShadeHelper::Initialize();
 			return true;
 		}();
@@ -131,14 +405,71 @@ namespace CRHooks
 
 		if (Plugin::AllowLiveUpdates)
 		{
+			// Shaders that were already replaced are indexed under the digest of the shader they replaced, since that's
+			// the name their file is looked up by
+			std::vector<ShaderDigest::Hash> containerDigests;
+
+			for (D3DPipelineStateStream::Iterator iter(StreamCopy.GetDesc()); !iter.AtEnd(); iter.Advance())
+			{
+				switch (auto obj = iter.GetObj(); obj->Type)
+				{
+				case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS:
+				case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS:
+				case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_HS:
+				case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DS:
+				case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_GS:
+				case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CS:
+				case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_AS:
+				case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_MS:
+					if (auto digest = DXContainer::GetDigest(obj->Shader.pShaderBytecode, obj->Shader.BytecodeLength))
+						containerDigests.emplace_back(D3DShaderReplacement::GetOriginalContainerDigest(*digest));
+					break;
+				}
+			}
+
+			char techniqueShortName[512];
+			D3DShaderReplacement::GetTechniqueShortName(Technique->m_Name, techniqueShortName);
+
 			std::scoped_lock lock(TrackedShaderDataLock);
+
 			TrackedPipelineData.emplace_back(TrackedDataEntry {
 				.Technique = Technique,
 				.StreamCopy = std::move(StreamCopy),
 			});
+
+			TrackedPipelineIndex.Add(techniqueShortName, Technique->m_Id, containerDigests);
 		}
 	}
 
+	bool RequiresPresentNotifications()
+	{
+		return Plugin::AllowLiveUpdates;
+	}
+
+	void OnPresent()
+	{
+		if (!RequiresPresentNotifications())
+			return;
+
+		PipelineRetirement::OnPresent();
+
+		if (Plugin::LiveUpdateSwapsPerFrame == 0)
+			return;
+
+		std::vector<PendingSwap> swaps;
+
+		{
+			std::scoped_lock lock(PendingSwapsLock);
+			const auto count = std::min<size_t>(PendingSwaps.size(), Plugin::LiveUpdateSwapsPerFrame);
+
+			swaps.assign(std::make_move_iterator(PendingSwaps.begin()), std::make_move_iterator(PendingSwaps.begin() + count));
+			PendingSwaps.erase(PendingSwaps.begin(), PendingSwaps.begin() + count);
+		}
+
+		for (auto& swap : swaps)
+			SwapPipelineState(swap);
+	}
+
 	bool OverridePipelineLayoutDx12(
 		ID3D12GraphicsCommandList4 *CommandList,
 		CreationRenderer::PipelineLayoutDx12 *CurrentLayout,
@@ -156,18 +487,29 @@ namespace CRHooks
 		//
 		bool updateRequired = CurrentLayout != TargetLayout;
 		auto rootSignature = TargetLayout->m_RootSignature;
+		auto currentRootSignature = CurrentLayout ? CurrentLayout->m_RootSignature : nullptr;
+		bool overridden = false;
 
-		// If the target technique requires an override OR the previous technique was overridden, force a flush
+		// If the target technique requires an override OR the previous technique was overridden, compare the
+		// signatures that are actually bound. Identical overrides share one object and don't need a flush.
 		if (auto itr = TrackedTechniqueIdToRootSignature.find((*TargetTech)->m_Id); itr != TrackedTechniqueIdToRootSignature.end())
 		{
-			updateRequired = true;
+			overridden = true;
 			rootSignature = itr->second.Get();
 		}
-		else if (!updateRequired && CurrentTech)
+
+		if (CurrentTech)
 		{
-			updateRequired = TrackedTechniqueIdToRootSignature.contains((*CurrentTech)->m_Id);
+			if (auto itr = TrackedTechniqueIdToRootSignature.find((*CurrentTech)->m_Id); itr != TrackedTechniqueIdToRootSignature.end())
+			{
+				overridden = true;
+				currentRootSignature = itr->second.Get();
+			}
 		}
 
+		if (overridden && currentRootSignature != rootSignature)
+			updateRequired = true;
+
 		if (updateRequired)
 		{
 			const auto type = *reinterpret_cast<CreationRenderer::ShaderType *>(
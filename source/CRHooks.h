@@ -13,4 +13,7 @@ namespace CRHooks
 		CreationRenderer::TechniqueData *Technique,
 		D3DPipelineStateStream::Copy&& StreamCopy,
 		bool WasPatchedUpfront);
+
+	bool RequiresPresentNotifications();
+	void OnPresent();
 }
@@ -5,6 +5,13 @@
 #include "D3DShaderReplacement.h"
 #include "DebuggingUtil.h"
 #include "D3Dhooks.h"
+#include "HitchMonitor.h"
+#include "PatchedPipelineLibrary.h"
+#include "PipelinePrewarm.h"
+#include "PipelineStateSharing.h"
+#include "PipelineTelemetry.h"
+#include "Plugin.h"
+#include "ShaderBinIndex.h"
 
 namespace D3DHooks
 {
@@ -24,6 +31,7 @@ namespace D3DHooks
 	thread_local CComPtr<ID3D12PipelineLibrary1> TLLastRequestedPipelineLibrary;
 	thread_local CreationRenderer::TechniqueData *TLLastRequestedShaderTechnique;
 	thread_local wchar_t TLLastRequestedPipelineName[64];
+	thread_local std::future<std::vector<D3DShaderReplacement::ResolvedShader>> TLPendingReplacementShaders;
 
 	HRESULT LoadPipelineForTechnique(
 		ID3D12PipelineLibrary1 *Thisptr,
@@ -37,6 +45,9 @@ namespace D3DHooks
 		TLLastRequestedShaderTechnique = Tech;
 		wcscpy_s(TLLastRequestedPipelineName, Name);
 
+		// Custom shaders are loaded and hashed while the game does its own work before calling CreatePipelineState
+		TLPendingReplacementShaders = D3DShaderReplacement::ResolveTechniqueAsync(Tech->m_Name, Tech->m_Id);
+
 		return E_INVALIDARG;
 	}
 
@@ -133,6 +144,12 @@ namespace D3DHooks
 
 		*PipelineState = nullptr;
 
+		PipelineTelemetry::Stopwatch stopwatch;
+		PipelineTelemetry::Sample sample {
+			.TechniqueId = Tech->m_Id,
+			.TechniqueName = Tech->m_Name,
+		};
+
 		// Note that streamCopy is initially a 1:1 copy since Desc is const. We don't know if a modification
 		// is applied until PatchPipelineStateStream returns.
 		D3DPipelineStateStream::Copy streamCopy(Desc);
@@ -143,13 +160,91 @@ namespace D3DHooks
 		// a precompiled copy.
 		bool shaderWasPatched = false;
 		bool shaderWasLoadedFromCache = false;
+		bool shaderWasShared = false;
+
+		// Blobs requested in LoadPipelineForTechnique are handed to patching when they're ready. Nothing waits on
+		// them since a saturated thread pool would put the wait on the critical path. Patching loads the files itself
+		// in that case. Results for another technique are dropped.
+		std::vector<D3DShaderReplacement::ResolvedShader> resolvedShaders;
+		auto pendingShaders = std::move(TLPendingReplacementShaders);
+
+		if (pendingShaders.valid() && TLLastRequestedShaderTechnique == Tech &&
+			pendingShaders.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+			resolvedShaders = pendingShaders.get();
+
+		// Modified pipelines are looked up in a separate library since the game's library only knows vanilla streams
+		wchar_t patchedPipelineName[64] = {};
+		const bool sharingEnabled = PipelineStateSharing::IsEnabled();
+		ShaderDigest::Hash fingerprint;
 
-		if (D3DShaderReplacement::PatchPipelineStateStream(streamCopy, Thisptr, &rootSignatureData, Tech->m_Name, Tech->m_Id))
+		auto findSharedPipeline = [&]()
+		{
+			if (auto pipelineState = PipelineStateSharing::Find(fingerprint))
+			{
+				*PipelineState = pipelineState.Detach();
+				sample.Source = PipelineTelemetry::PipelineSource::Shared;
+
+				return true;
+			}
+
+			return false;
+		};
+
+		if (D3DShaderReplacement::PatchPipelineStateStream(
+				streamCopy,
+				Thisptr,
+				&rootSignatureData,
+				Tech->m_Name,
+				Tech->m_Id,
+				resolvedShaders))
 		{
 			shaderWasPatched = true;
+
+			const bool prewarmEnabled = PipelinePrewarm::IsEnabled();
+			const bool libraryEnabled = PatchedPipelineLibrary::IsEnabled();
+
+			if (sharingEnabled || prewarmEnabled || libraryEnabled)
+				fingerprint = D3DPipelineStateStream::Fingerprint(streamCopy.GetDesc(), &rootSignatureData);
+
+			if (prewarmEnabled)
+				PipelinePrewarm::Record(Desc, rootSignatureData, Tech->m_Name, Tech->m_Id, fingerprint);
+
+			sample.PatchTime = stopwatch.Lap();
+
+			if (sharingEnabled)
+				shaderWasShared = findSharedPipeline();
+
+			if (prewarmEnabled && !shaderWasShared)
+			{
+				if (auto pipelineState = PipelinePrewarm::Take(fingerprint))
+				{
+					*PipelineState = pipelineState.Detach();
+					shaderWasLoadedFromCache = true;
+					sample.Source = PipelineTelemetry::PipelineSource::Prewarmed;
+				}
+			}
+
+			if (libraryEnabled && !shaderWasShared && !shaderWasLoadedFromCache)
+			{
+				PatchedPipelineLibrary::GetPipelineName(Tech->m_Id, fingerprint, patchedPipelineName);
+
+				shaderWasLoadedFromCache = PatchedPipelineLibrary::LoadPipeline(
+					Thisptr,
+					patchedPipelineName,
+					streamCopy.GetDesc(),
+					Riid,
+					PipelineState);
+
+				sample.LibraryQueried = true;
+
+				if (shaderWasLoadedFromCache)
+					sample.Source = PipelineTelemetry::PipelineSource::PatchedLibrary;
+			}
 		}
 		else
 		{
+			sample.PatchTime = stopwatch.Lap();
+
 			if (TLLastRequestedPipelineLibrary && TLLastRequestedShaderTechnique == Tech)
 			{
 				if (SUCCEEDED(TLLastRequestedPipelineLibrary->LoadPipeline(
@@ -157,15 +252,23 @@ namespace D3DHooks
 					streamCopy.GetDesc(),
 					Riid,
 					PipelineState)))
+				{
 					shaderWasLoadedFromCache = true;
+					sample.Source = PipelineTelemetry::PipelineSource::GameLibrary;
+				}
+
+				sample.LibraryQueried = true;
 			}
 		}
 
+		sample.LibraryTime = stopwatch.Lap();
+
 		TLLastRequestedPipelineLibrary = nullptr;
 		TLLastRequestedShaderTechnique = nullptr;
+
 		TLNextShaderTechniqueToSkipCaching = (shaderWasLoadedFromCache || shaderWasPatched) ? Tech : nullptr;
 
-		if (!shaderWasLoadedFromCache)
+		if (!shaderWasLoadedFromCache && !shaderWasShared)
 		{
 			const auto hr = Thisptr->CreatePipelineState(streamCopy.GetDesc(), Riid, PipelineState);
 
@@ -182,8 +285,21 @@ namespace D3DHooks
 
 				return hr;
 			}
+
+			sample.CompileTime = stopwatch.Lap();
+
+			if (patchedPipelineName[0] != L'\0')
+				PatchedPipelineLibrary::StorePipeline(patchedPipelineName, static_cast<ID3D12PipelineState *>(*PipelineState));
 		}
 
+		if (shaderWasShared)
+			spdlog::trace(
+				"Reused an identical pipeline for technique {:X}. {} compile(s) avoided so far.",
+				Tech->m_Id,
+				PipelineStateSharing::GetAvoidedCompileCount());
+		else if (sharingEnabled && shaderWasPatched)
+			PipelineStateSharing::Register(fingerprint, static_cast<ID3D12PipelineState *>(*PipelineState));
+
 		// Tech can't be used because it's allocated on the stack and quickly discarded. PipelineState is a
 		// pointer within another TechniqueData struct that's stored in a global array - a suitable alternative.
 		auto globalTech = reinterpret_cast<ptrdiff_t>(PipelineState) - offsetof(CreationRenderer::TechniqueData, m_PipelineState);
@@ -194,7 +310,14 @@ namespace D3DHooks
 			std::move(streamCopy),
 			shaderWasPatched);
 
-		DebuggingUtil::SetObjectDebugName(static_cast<ID3D12PipelineState *>(*PipelineState), Tech->m_Name);
+		// Shared pipelines keep the name of the technique that created them
+		if (!shaderWasShared)
+			DebuggingUtil::SetObjectDebugName(static_cast<ID3D12PipelineState *>(*PipelineState), Tech->m_Name);
+
+		sample.Patched = shaderWasPatched;
+		PipelineTelemetry::Record(sample);
+		HitchMonitor::RecordPipeline(sample);
+
 		return S_OK;
 	}
 
@@ -220,6 +343,29 @@ namespace D3DHooks
 		}
 	};
 
+	//
+	// FidelityFX recreates its pipelines on every resolution or mode change and has no pipeline library in front of
+	// them. Results are kept by the fingerprint of the game's stream. The whole cache goes stale when the shader index
+	// is rebuilt since custom shaders might've changed.
+	//
+	// Each mode only uses a few dozen pipelines. Once the limit is hit, pipelines FidelityFX has released are dropped
+	// and nothing new is cached if all of them are still in use.
+	//
+	// Live updates bypass the cache. Every creation goes through patching so edited shaders are always picked up.
+	//
+	struct FFXPipelineEntry
+	{
+		uint64_t TechniqueId = 0;
+		CComPtr<ID3D12RootSignature> RootSignature; // Keeps the pointer in the fingerprint from being reused
+		CComPtr<ID3D12PipelineState> PipelineState;
+	};
+
+	constexpr size_t MaxFFXPipelines = 256;
+
+	std::mutex FFXPipelinesLock;
+	std::unordered_map<ShaderDigest::Hash, FFXPipelineEntry, ShaderDigest::Hasher> FFXPipelines;
+	uint64_t FFXPipelinesGeneration = 0;
+
 	//
 	// Identical to CreatePipelineStateForTechnique but intercepts the call to CreateGraphicsPipelineState that
 	// FidelityFX's SDK uses.
@@ -237,12 +383,10 @@ namespace D3DHooks
 
 		*PipelineState = nullptr;
 
-		// FFX doesn't have debug names so we have to fake one
-		const auto fakeTechniqueId = static_cast<uint64_t>(DebuggingUtil::FNV1A32(Desc->VS.pShaderBytecode, Desc->VS.BytecodeLength)) << 32ull |
-									 static_cast<uint64_t>(DebuggingUtil::FNV1A32(Desc->PS.pShaderBytecode, Desc->PS.BytecodeLength));
-
-		char fakeTechniqueName[128];
-		sprintf_s(fakeTechniqueName, "FidelityFX3FI- (%llX)", fakeTechniqueId);
+		PipelineTelemetry::Stopwatch stopwatch;
+		PipelineTelemetry::Sample sample {
+			.TechniqueName = "FidelityFX",
+		};
 
 		// Upgrade CreateGraphicsPipelineState's legacy structure to CreatePipelineState's bytestream description
 		struct
@@ -305,10 +449,56 @@ namespace D3DHooks
 			.pPipelineStateSubobjectStream = &upgradedStreamData,
 		};
 
+		// Shaders only contribute their container digest so this is far cheaper than hashing the bytecode below
+		const bool useCache = !Plugin::AllowLiveUpdates;
+		const auto fingerprint = useCache ? D3DPipelineStateStream::Fingerprint(&upgradedStreamDesc, nullptr) : ShaderDigest::Hash {};
+		const auto indexGeneration = ShaderBinIndex::GetGeneration();
+
+		if (useCache)
+		{
+			std::scoped_lock lock(FFXPipelinesLock);
+
+			if (auto itr = FFXPipelines.find(fingerprint); itr != FFXPipelines.end() && FFXPipelinesGeneration == indexGeneration)
+			{
+				itr->second.PipelineState->AddRef();
+				*PipelineState = itr->second.PipelineState.Get();
+
+				sample.TechniqueId = itr->second.TechniqueId;
+				sample.LibraryTime = stopwatch.Lap();
+				sample.Source = PipelineTelemetry::PipelineSource::Shared;
+				PipelineTelemetry::Record(sample);
+				HitchMonitor::RecordPipeline(sample);
+
+				return S_OK;
+			}
+		}
+
+		// FFX doesn't have debug names so we have to fake one. Hashing is skipped when only container digest
+		// replacements are installed.
+		uint64_t fakeTechniqueId = 0;
+
+		if (D3DShaderReplacement::RequiresTechniqueIds())
+		{
+			fakeTechniqueId = static_cast<uint64_t>(DebuggingUtil::FNV1A32(Desc->VS.pShaderBytecode, Desc->VS.BytecodeLength)) << 32ull |
+							  static_cast<uint64_t>(DebuggingUtil::FNV1A32(Desc->PS.pShaderBytecode, Desc->PS.BytecodeLength));
+		}
+
+		char fakeTechniqueName[128];
+		sprintf_s(fakeTechniqueName, "FidelityFX3FI- (%llX)", fakeTechniqueId);
+
 		D3DPipelineStateStream::Copy streamCopy(&upgradedStreamDesc);
-		D3DShaderReplacement::PatchPipelineStateStream(streamCopy, Thisptr, nullptr, fakeTechniqueName, fakeTechniqueId);
+		sample.TechniqueId = fakeTechniqueId;
+		sample.Patched = D3DShaderReplacement::PatchPipelineStateStream(
+			streamCopy,
+			Thisptr,
+			nullptr,
+			fakeTechniqueName,
+			fakeTechniqueId,
+			{});
+		sample.PatchTime = stopwatch.Lap();
 
 		const auto hr = Thisptr->CreatePipelineState(streamCopy.GetDesc(), Riid, PipelineState);
+		sample.CompileTime = stopwatch.Lap();
 
 		if (FAILED(hr))
 		{
@@ -324,6 +514,42 @@ namespace D3DHooks
 			return hr;
 		}
 
+		if (useCache)
+		{
+			std::scoped_lock lock(FFXPipelinesLock);
+
+			if (FFXPipelinesGeneration != indexGeneration)
+			{
+				FFXPipelines.clear();
+				FFXPipelinesGeneration = indexGeneration;
+			}
+
+			if (FFXPipelines.size() >= MaxFFXPipelines)
+			{
+				std::erase_if(
+					FFXPipelines,
+					[](const auto& Entry)
+					{
+						// Only referenced by this map
+						Entry.second.PipelineState->AddRef();
+						return Entry.second.PipelineState->Release() == 1;
+					});
+			}
+
+			if (FFXPipelines.size() < MaxFFXPipelines)
+			{
+				FFXPipelines.insert_or_assign(
+					fingerprint,
+					FFXPipelineEntry {
+						.TechniqueId = fakeTechniqueId,
+						.RootSignature = Desc->pRootSignature,
+						.PipelineState = static_cast<ID3D12PipelineState *>(*PipelineState),
+					});
+			}
+		}
+
+		PipelineTelemetry::Record(sample);
+		HitchMonitor::RecordPipeline(sample);
 		return S_OK;
 	}
 
@@ -1,4 +1,5 @@
 #include "D3DPipelineStateStream.h"
+#include "PipelineFingerprint.h"
 
 namespace D3DPipelineStateStream
 {
@@ -29,7 +30,7 @@ namespace D3DPipelineStateStream
 		return reinterpret_cast<D3D12_PTR_PSO_SUBOBJECT *>(m_Start);
 	}
 
-	size_t Iterator::GetSizeForType(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type) const
+	size_t Iterator::GetSizeForType(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type)
 	{
 		switch (Type)
 		{
@@ -98,7 +99,7 @@ namespace D3DPipelineStateStream
 		std::unreachable();
 	}
 
-	size_t Iterator::GetAlignmentForType(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type) const
+	size_t Iterator::GetAlignmentForType(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type)
 	{
 		switch (Type)
 		{
@@ -175,12 +176,25 @@ namespace D3DPipelineStateStream
 	Copy::Copy(Copy&& Other) noexcept
 	{
 		m_TempBuffers = std::move(Other.m_TempBuffers);
+		m_SharedBuffers = std::move(Other.m_SharedBuffers);
 		m_RefCountedObjects = std::move(Other.m_RefCountedObjects);
 
 		m_CopiedDesc = Other.m_CopiedDesc;
 		Other.m_CopiedDesc = {};
 	}
 
+	Copy& Copy::operator=(Copy&& Other) noexcept
+	{
+		m_TempBuffers = std::move(Other.m_TempBuffers);
+		m_SharedBuffers = std::move(Other.m_SharedBuffers);
+		m_RefCountedObjects = std::move(Other.m_RefCountedObjects);
+
+		m_CopiedDesc = Other.m_CopiedDesc;
+		Other.m_CopiedDesc = {};
+
+		return *this;
+	}
+
 	void Copy::CreateCopy(const D3D12_PIPELINE_STATE_STREAM_DESC *InputDesc)
 	{
 		// Do a memcpy up front and then patch the pointers as needed
@@ -235,4 +249,95 @@ namespace D3DPipelineStateStream
 			}
 		}
 	}
+
+	ShaderDigest::Hash Fingerprint(const D3D12_PIPELINE_STATE_STREAM_DESC *Description, const std::span<const uint8_t> *RootSignatureData)
+	{
+		PipelineFingerprint::Builder builder;
+
+		for (Iterator iter(Description); !iter.AtEnd(); iter.Advance())
+		{
+			const auto obj = iter.GetObj();
+			builder.BeginSubobject(obj->Type);
+
+			switch (obj->Type)
+			{
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_HS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_GS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_AS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_MS:
+				builder.AddShader(obj->Shader.pShaderBytecode, obj->Shader.BytecodeLength);
+				break;
+
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CACHED_PSO:
+				// Not part of the pipeline's identity
+				break;
+
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE:
+			{
+				std::optional<ShaderDigest::Hash> tag;
+
+				if (obj->RootSignature)
+				{
+					ShaderDigest::Hash digest;
+					UINT digestSize = sizeof(digest);
+
+					if (SUCCEEDED(obj->RootSignature->GetPrivateData(IID_RootSignatureDigest, &digestSize, &digest)) &&
+						digestSize == sizeof(digest))
+						tag = digest;
+				}
+
+				builder.AddRootSignature(obj->RootSignature, tag, RootSignatureData);
+			}
+			break;
+
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_STREAM_OUTPUT:
+				for (UINT i = 0; i < obj->StreamOutput.NumEntries; i++)
+				{
+					auto entry = obj->StreamOutput.pSODeclaration[i];
+					builder.AddString(entry.SemanticName);
+
+					entry.SemanticName = nullptr;
+					builder.AddValue(entry);
+				}
+
+				builder.Add(obj->StreamOutput.pBufferStrides, obj->StreamOutput.NumStrides * sizeof(UINT));
+				builder.AddValue(obj->StreamOutput.RasterizedStream);
+				break;
+
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT:
+				for (UINT i = 0; i < obj->InputLayout.NumElements; i++)
+				{
+					auto element = obj->InputLayout.pInputElementDescs[i];
+					builder.AddString(element.SemanticName);
+
+					element.SemanticName = nullptr;
+					builder.AddValue(element);
+				}
+				break;
+
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VIEW_INSTANCING:
+				builder.Add(
+					obj->ViewInstancing.pViewInstanceLocations,
+					obj->ViewInstancing.ViewInstanceCount * sizeof(D3D12_VIEW_INSTANCE_LOCATION));
+				builder.AddValue(obj->ViewInstancing.Flags);
+				break;
+
+			default:
+			{
+				// Plain data right after the type field
+				const auto alignment = iter.GetAlignmentForType(obj->Type);
+				const auto payloadOffset = (sizeof(obj->Type) + alignment - 1) & ~(alignment - 1);
+
+				builder.Add(reinterpret_cast<const uint8_t *>(obj) + payloadOffset, iter.GetSizeForType(obj->Type));
+			}
+			break;
+			}
+		}
+
+		return builder.Finish();
+	}
 }
@@ -1,9 +1,13 @@
 #pragma once
 
 #include "CComPtr.h"
+#include "ShaderDigest.h"
 
 namespace D3DPipelineStateStream
 {
+	// Private data attached to root signatures created from custom blobs. Holds the blob's ShaderDigest::Hash.
+	constexpr GUID IID_RootSignatureDigest = { 0xda90a52d, 0xa555, 0x4edb, { 0xb9, 0xe1, 0x80, 0x52, 0x5d, 0xc0, 0x5c, 0xe4 } };
+
 	// Thanks to RenderDoc source code for providing some insight. What a mess this was...
 	//
 	// NOTE: D3DX12ParsePipelineStream is close to what I want. However, what I don't want
@@ -45,8 +49,8 @@ namespace D3DPipelineStateStream
 		bool AtEnd() const;
 		D3D12_PTR_PSO_SUBOBJECT *GetObj() const;
 
-		size_t GetSizeForType(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type) const;
-		size_t GetAlignmentForType(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type) const;
+		static size_t GetSizeForType(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type);
+		static size_t GetAlignmentForType(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type);
 
 	private:
 		template<typename T>
@@ -60,6 +64,7 @@ namespace D3DPipelineStateStream
 	{
 	private:
 		std::vector<std::unique_ptr<uint8_t[]>> m_TempBuffers;
+		std::vector<std::shared_ptr<const void>> m_SharedBuffers;
 		std::vector<CComPtr<IUnknown>> m_RefCountedObjects;
 		D3D12_PIPELINE_STATE_STREAM_DESC m_CopiedDesc = {};
 
@@ -68,11 +73,19 @@ namespace D3DPipelineStateStream
 		Copy(const Copy& Other) = delete;
 		Copy(Copy&& Other) noexcept;
 
+		Copy& operator=(const Copy& Other) = delete;
+		Copy& operator=(Copy&& Other) noexcept;
+
 		void TrackAllocation(std::unique_ptr<uint8_t[]>&& Allocation)
 		{
 			m_TempBuffers.emplace_back(std::forward<std::unique_ptr<uint8_t[]>>(Allocation));
 		}
 
+		void TrackSharedAllocation(std::shared_ptr<const void> Allocation)
+		{
+			m_SharedBuffers.emplace_back(std::move(Allocation));
+		}
+
 		template<typename T>
 		void TrackObject(CComPtr<T>&& Object)
 		{
@@ -97,4 +110,11 @@ namespace D3DPipelineStateStream
 			return reinterpret_cast<T *>(memcpy(ptr.get(), Data, Size));
 		}
 	};
+
+	//
+	// Content hash of a pipeline state stream that's stable across processes. Pointers are replaced by the data they
+	// point to. Root signatures are identified by their blob: tagged custom signatures use the tag, all others use
+	// RootSignatureData if given and fall back to the object address otherwise.
+	//
+	ShaderDigest::Hash Fingerprint(const D3D12_PIPELINE_STATE_STREAM_DESC *Description, const std::span<const uint8_t> *RootSignatureData);
 }
@@ -1,11 +1,51 @@
 #include "CComPtr.h"
 #include "D3DPipelineStateStream.h"
 #include "D3DShaderReplacement.h"
-#include "DebuggingUtil.h"
+#include "DXContainer.h"
 #include "Plugin.h"
+#include "ShaderBinIndex.h"
+#include "ShaderBlobCache.h"
+#include "ShaderDumpFilter.h"
+#include "ShaderDumpWriter.h"
 
 namespace D3DShaderReplacement
 {
+	void Initialize()
+	{
+		// Replacements are resolved from an in-memory index instead of probing the file system for every shader
+		// stage of every pipeline. Dumping doesn't need one.
+		if (!Plugin::ShaderDumpBinPath.empty())
+		{
+			ShaderDumpFilter::Initialize(
+				Plugin::ShaderDumpIncludeTechniques,
+				Plugin::ShaderDumpExcludeTechniques,
+				Plugin::ShaderDumpTechniqueIds,
+				Plugin::ShaderDumpStages);
+
+			ShaderDumpWriter::Initialize(GetShaderBinDirectory());
+			return;
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+		ShaderBinIndex::Build(GetShaderBinDirectories());
+		const auto end = std::chrono::steady_clock::now();
+
+		spdlog::info(
+			"Indexed {} custom shader file(s) in {} ms.",
+			ShaderBinIndex::GetEntryCount(),
+			std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+
+		if (Plugin::PrefetchShaders && ShaderBinIndex::GetEntryCount() > 0)
+		{
+			std::thread(
+				[]()
+				{
+					ShaderBlobCache::Prefetch(ShaderBinIndex::GetEntries());
+				})
+				.detach();
+		}
+	}
+
 	const std::filesystem::path& GetShaderBinDirectory()
 	{
 		const static auto path = []()
@@ -22,6 +62,35 @@ namespace D3DShaderReplacement
 		return path;
 	}
 
+	const std::vector<std::filesystem::path>& GetShaderBinDirectories()
+	{
+		// The main directory is the lowest priority layer. Overlays are applied on top of it in the order they're
+		// listed. Relative paths are relative to the game directory.
+		const static auto paths = []()
+		{
+			std::vector<std::filesystem::path> temp { GetShaderBinDirectory() };
+
+			for (const auto& overlay : Plugin::ShaderOverlayPaths)
+			{
+				auto path = std::filesystem::current_path() / overlay;
+				std::error_code ec;
+
+				if (!std::filesystem::is_directory(path, ec))
+				{
+					spdlog::warn("Custom shader overlay directory doesn't exist: {}", path.string());
+					continue;
+				}
+
+				spdlog::info("Using custom shader overlay directory: {}", path.string());
+				temp.emplace_back(std::move(path));
+			}
+
+			return temp;
+		}();
+
+		return paths;
+	}
+
 	const char *GetShaderTypePrefix(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type)
 	{
 		switch (Type)
@@ -49,92 +118,332 @@ namespace D3DShaderReplacement
 		return "unknown";
 	}
 
-	bool ExtractOrReplaceShader(
-		D3DPipelineStateStream::Copy& StreamCopy,
-		D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type,
-		D3D12_SHADER_BYTECODE *Bytecode,
-		const char *TechniqueName,
-		uint64_t TechniqueId)
+	// Live updates re-patch streams that already contain replaced shaders. Digest keyed replacements need to be
+	// traced back to the shader they originally replaced.
+	std::mutex ReplacedContainerDigestsLock;
+	std::unordered_map<ShaderDigest::Hash, ShaderDigest::Hash, ShaderDigest::Hasher> ReplacedContainerDigests;
+
+	void TrackReplacedContainerDigest(const ShaderDigest::Hash& Replacement, const ShaderDigest::Hash& Original)
 	{
-		// Techniques have to be trimmed as they're too long to be used in file names
-		const auto prefix = GetShaderTypePrefix(Type);
+		std::scoped_lock lock(ReplacedContainerDigestsLock);
+		ReplacedContainerDigests.insert_or_assign(Replacement, Original);
+	}
 
-		char techniqueShortName[512] = {};
-		strncpy_s(techniqueShortName, TechniqueName, _TRUNCATE);
+	ShaderDigest::Hash GetOriginalContainerDigest(const ShaderDigest::Hash& Digest)
+	{
+		std::scoped_lock lock(ReplacedContainerDigestsLock);
 
-		if (auto s = strchr(techniqueShortName, '-'))
-			*s = '\0';
+		if (auto itr = ReplacedContainerDigests.find(Digest); itr != ReplacedContainerDigests.end())
+			return itr->second;
 
-		char shaderBinFileName[512];
-		sprintf_s(shaderBinFileName, "%s_%llX_%s.bin", techniqueShortName, TechniqueId, prefix);
+		return Digest;
+	}
 
-		const auto shaderBinFullPath = GetShaderBinDirectory() / techniqueShortName / shaderBinFileName;
+	// Verdicts are keyed by the replacement's digest since the same file can be used for several shaders
+	std::mutex ValidationResultsLock;
+	std::unordered_map<ShaderDigest::Hash, bool, ShaderDigest::Hasher> ValidationResults;
 
-		if (!Plugin::ShaderDumpBinPath.empty())
+	bool IsReplacementCompatible(
+		std::span<const uint8_t> Replacement,
+		const ShaderDigest::Hash& ReplacementDigest,
+		const std::filesystem::path& ReplacementPath)
+	{
 		{
-			// Extract it
-			if (Bytecode->pShaderBytecode && Bytecode->BytecodeLength != 0)
+			std::scoped_lock lock(ValidationResultsLock);
+
+			if (auto itr = ValidationResults.find(ReplacementDigest); itr != ValidationResults.end())
+				return itr->second;
+		}
+
+		std::string error;
+		const bool compatible = DXContainer::IsCompatibleReplacement(Replacement, error);
+
+		if (!compatible)
+			spdlog::error("Skipping incompatible custom shader {}: {}.", ReplacementPath.string(), error);
+
+		std::scoped_lock lock(ValidationResultsLock);
+		ValidationResults.emplace(ReplacementDigest, compatible);
+
+		return compatible;
+	}
+
+	struct PatchedShader
+	{
+		D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type = {};
+		D3D12_SHADER_BYTECODE *Bytecode = nullptr;
+		D3D12_SHADER_BYTECODE Original = {};
+		bool Replaced = false;
+	};
+
+	bool IsLinkageValid(std::span<const PatchedShader> Shaders, const D3D12_INPUT_LAYOUT_DESC *InputLayout, std::string& Error)
+	{
+		// Stages in the order data flows through them. Amplification shaders only hand a payload to mesh shaders. Only
+		// links with a replaced shader on either end are checked.
+		const PatchedShader *upstream = nullptr;
+
+		for (const auto type : {
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_HS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_GS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_MS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS,
+			 })
+		{
+			const auto shader = std::find_if(
+				Shaders.begin(),
+				Shaders.end(),
+				[&](const PatchedShader& Shader)
+				{
+					return Shader.Type == type && Shader.Bytecode->pShaderBytecode && Shader.Bytecode->BytecodeLength != 0;
+				});
+
+			if (shader == Shaders.end())
+				continue;
+
+			auto parse = [&](const PatchedShader& Shader)
 			{
-				// Calculate the shader data hash, dump it, then map it to a technique name in a dedicated CSV file. It's
-				// far from efficient but it's usually a one-time operation.
-				std::filesystem::create_directories(shaderBinFullPath.parent_path());
+				std::string unused;
+				return DXContainer::Parse(
+					{ static_cast<const uint8_t *>(Shader.Bytecode->pShaderBytecode), Shader.Bytecode->BytecodeLength },
+					unused);
+			};
 
-				const auto hash = DebuggingUtil::FNV1A32(Bytecode->pShaderBytecode, Bytecode->BytecodeLength);
-				spdlog::info("Dumping shader with hash {} to {}", hash, shaderBinFullPath.string());
+			const auto container = (shader->Replaced || (upstream && upstream->Replaced)) ? parse(*shader) : std::nullopt;
+			const auto inputs = container ? DXContainer::GetInputSignature(*container) : std::nullopt;
 
-				static std::mutex fileDumpMutex;
-				fileDumpMutex.lock();
+			if (inputs && upstream)
+			{
+				const auto upstreamContainer = parse(*upstream);
+				const auto outputs = upstreamContainer ? DXContainer::GetOutputSignature(*upstreamContainer) : std::nullopt;
+
+				if (outputs && !DXContainer::AreInputsProvided(*inputs, *outputs, GetShaderTypePrefix(upstream->Type), Error))
 				{
-					// Dump binary
-					if (std::ofstream f(shaderBinFullPath, std::ios::binary); f.good())
-						f.write(reinterpret_cast<const char *>(Bytecode->pShaderBytecode), Bytecode->BytecodeLength);
+					Error = std::string(GetShaderTypePrefix(type)) + " " + Error;
+					return false;
+				}
+			}
+			else if (inputs && type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS && InputLayout)
+			{
+				std::vector<DXContainer::SignatureElement> layout;
 
-					// Append to CSV
-					const static auto csvPath = Plugin::ShaderDumpBinPath / "ShaderTechniqueMap.csv";
+				for (uint32_t i = 0; i < InputLayout->NumElements; i++)
+				{
+					const auto& element = InputLayout->pInputElementDescs[i];
+					layout.emplace_back(DXContainer::SignatureElement {
+						.SemanticName = element.SemanticName ? element.SemanticName : "",
+						.SemanticIndex = element.SemanticIndex,
+					});
+				}
 
-					if (std::ofstream f(csvPath, std::ios::app); f.good())
-					{
-						char csvLine[2048];
-						auto length = sprintf_s(
-							csvLine,
-							"%s,%s,%u,%llX,\"%s\"\n",
-							techniqueShortName,
-							prefix,
-							hash,
-							TechniqueId,
-							TechniqueName);
-
-						f.write(csvLine, length);
-					}
+				if (!DXContainer::AreInputsProvided(*inputs, layout, "the input layout", Error))
+				{
+					Error = std::string(GetShaderTypePrefix(type)) + " " + Error;
+					return false;
 				}
-				fileDumpMutex.unlock();
 			}
+
+			upstream = &*shader;
+		}
+
+		return true;
+	}
+
+	void GetTechniqueShortName(const char *TechniqueName, char (&Output)[512])
+	{
+		// Techniques have to be trimmed as they're too long to be used in file names
+		strncpy_s(Output, TechniqueName, _TRUNCATE);
+
+		if (auto s = strchr(Output, '-'))
+			*s = '\0';
+	}
+
+	bool RequiresTechniqueIds()
+	{
+		return !Plugin::ShaderDumpBinPath.empty() || ShaderBinIndex::HasTechniqueEntries();
+	}
+
+	struct ResolveTask
+	{
+		std::vector<ShaderBinIndex::Entry> Entries;
+		std::promise<std::vector<ResolvedShader>> Promise;
+	};
+
+	void CALLBACK ResolveTechniqueCallback(PTP_CALLBACK_INSTANCE Instance, void *Context)
+	{
+		std::unique_ptr<ResolveTask> task(static_cast<ResolveTask *>(Context));
+		std::vector<ResolvedShader> shaders;
+
+		for (auto& entry : task->Entries)
+		{
+			if (auto blob = ShaderBlobCache::Load(entry))
+			{
+				shaders.emplace_back(ResolvedShader {
+					.File = std::move(entry),
+					.Blob = std::move(*blob),
+				});
+			}
+		}
+
+		task->Promise.set_value(std::move(shaders));
+	}
+
+	std::future<std::vector<ResolvedShader>> ResolveTechniqueAsync(const char *TechniqueName, uint64_t TechniqueId)
+	{
+		if (!Plugin::ShaderDumpBinPath.empty() || !ShaderBinIndex::HasTechniqueEntries())
+			return {};
+
+		// Index probes are cheap and done right away. Only techniques with custom shaders pay for a task.
+		char techniqueShortName[512];
+		GetTechniqueShortName(TechniqueName, techniqueShortName);
+
+		std::vector<ShaderBinIndex::Entry> entries;
+
+		for (const auto type : {
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_HS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_GS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_AS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_MS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE,
+			 })
+		{
+			if (auto entry = ShaderBinIndex::Lookup(techniqueShortName, TechniqueId, type))
+				entries.emplace_back(std::move(*entry));
 		}
+
+		if (entries.empty())
+			return {};
+
+		// Loading stalls on disk I/O. Tasks go to the process thread pool instead of spawning a thread per technique.
+		auto task = std::make_unique<ResolveTask>(std::move(entries));
+		auto result = task->Promise.get_future();
+
+		if (TrySubmitThreadpoolCallback(&ResolveTechniqueCallback, task.get(), nullptr))
+			task.release();
 		else
+			ResolveTechniqueCallback(nullptr, task.release());
+
+		return result;
+	}
+
+	bool ExtractOrReplaceShader(
+		D3DPipelineStateStream::Copy& StreamCopy,
+		D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type,
+		D3D12_SHADER_BYTECODE *Bytecode,
+		const char *TechniqueName,
+		uint64_t TechniqueId,
+		std::span<const ResolvedShader> ResolvedShaders)
+	{
+		const auto prefix = GetShaderTypePrefix(Type);
+		char techniqueShortName[512];
+
+		if (!Plugin::ShaderDumpBinPath.empty())
 		{
-			// Replace it
-			if (std::ifstream f(shaderBinFullPath, std::ios::binary | std::ios::ate); f.good())
+			GetTechniqueShortName(TechniqueName, techniqueShortName);
+
+			// Extract it. Files are written on a background thread since dumping can cover tens of thousands of shaders
+			// during loading. Filtered shaders aren't even copied.
+			if (Bytecode->pShaderBytecode && Bytecode->BytecodeLength != 0 &&
+				ShaderDumpFilter::Matches(techniqueShortName, TechniqueId, Type))
+			{
+				ShaderDumpWriter::Enqueue(
+					techniqueShortName,
+					TechniqueName,
+					TechniqueId,
+					prefix,
+					{ static_cast<const uint8_t *>(Bytecode->pShaderBytecode), Bytecode->BytecodeLength });
+			}
+		}
+		else
+		{
+			// Replace it. The index lookup is purely in-memory so the common case (no custom shader) never touches
+			// the file system. Replacements keyed by the original container digest take priority and don't depend on
+			// technique names or ids.
+			std::optional<ShaderBinIndex::Entry> entry;
+			auto containerDigest = DXContainer::GetDigest(Bytecode->pShaderBytecode, Bytecode->BytecodeLength);
+
+			if (containerDigest)
+			{
+				if (Plugin::AllowLiveUpdates)
+					containerDigest = GetOriginalContainerDigest(*containerDigest);
+
+				entry = ShaderBinIndex::LookupByContainerDigest(*containerDigest);
+			}
+
+			if (!entry && ShaderBinIndex::HasTechniqueEntries())
+			{
+				GetTechniqueShortName(TechniqueName, techniqueShortName);
+				entry = ShaderBinIndex::Lookup(techniqueShortName, TechniqueId, Type);
+			}
+
+			if (!entry)
+				return false;
+
+			// Shaders resolved ahead of time are used as-is. Anything else, e.g. container digest replacements, is
+			// loaded through the blob cache.
+			auto loadBlob = [&]() -> std::optional<ShaderBlobCache::Entry>
+			{
+				for (const auto& resolved : ResolvedShaders)
+				{
+					if (resolved.File.Path == entry->Path && resolved.File.BundleDigest == entry->BundleDigest &&
+						resolved.File.FileSize == entry->FileSize && resolved.File.LastWriteTime == entry->LastWriteTime)
+						return resolved.Blob;
+				}
+
+				return ShaderBlobCache::Load(*entry);
+			};
+
+			if (auto cached = loadBlob())
 			{
 				static bool once = [&]()
 				{
-					spdlog::info("Trying to replace at least one shader: {}", shaderBinFullPath.string());
+					spdlog::info("Trying to replace at least one shader: {}", entry->Path.string());
 					return true;
 				}();
 
-				auto fileSize = static_cast<uint64_t>(f.tellg());
-				auto fileData = std::make_unique<uint8_t[]>(fileSize);
+				const auto fileData = cached->Blob->GetData();
 
-				f.seekg(0, std::ios::beg);
-				f.read(reinterpret_cast<char *>(fileData.get()), fileSize);
+				// Only replace if the on-disk data is different. Signed containers carry their own digest in the header.
+				// Unsigned blobs are only hashed when the sizes match.
+				auto isSameShader = [&]()
+				{
+					if (fileData.size() != Bytecode->BytecodeLength)
+						return false;
+
+					const auto originalDigest = DXContainer::GetDigest(Bytecode->pShaderBytecode, Bytecode->BytecodeLength);
+					const auto fileDigest = DXContainer::GetDigest(fileData.data(), fileData.size());
+
+					if (originalDigest && fileDigest)
+						return *originalDigest == *fileDigest;
 
-				// Only replace if the on-disk data is different
-				if (fileSize != Bytecode->BytecodeLength || memcmp(fileData.get(), Bytecode->pShaderBytecode, fileSize) != 0)
+					return ShaderDigest::Compute(Bytecode->pShaderBytecode, Bytecode->BytecodeLength) == cached->Digest;
+				};
+
+				if (!isSameShader())
 				{
-					Bytecode->BytecodeLength = fileSize;
-					Bytecode->pShaderBytecode = fileData.get();
-					StreamCopy.TrackAllocation(std::move(fileData));
+					// Broken replacements would otherwise only show up as a failed pipeline creation. Root signatures
+					// are validated by CreateRootSignature instead.
+					if (Plugin::ValidateCustomShaders && Type != D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE &&
+						!IsReplacementCompatible(fileData, cached->Digest, entry->Path))
+						return false;
+
+					// The stream copy holds a reference to the blob. Mapped files stay mapped for as long as any pipeline
+					// refers to them, even after the cache evicts them.
+					Bytecode->BytecodeLength = fileData.size();
+					Bytecode->pShaderBytecode = fileData.data();
+					StreamCopy.TrackSharedAllocation(std::move(cached->Blob));
 
-					spdlog::trace("Used file replacement: {}", shaderBinFullPath.string());
+					if (Plugin::AllowLiveUpdates && containerDigest)
+					{
+						if (auto newDigest = DXContainer::GetDigest(fileData.data(), fileData.size()))
+							TrackReplacedContainerDigest(*newDigest, *containerDigest);
+					}
+
+					spdlog::trace("Used file replacement: {}", entry->Path.string());
 					return true;
 				}
 			}
@@ -143,14 +452,58 @@ namespace D3DShaderReplacement
 		return false;
 	}
 
+	// Many techniques share one root signature. Identical replacements map to a single object per device, which also
+	// lets the command list hooks skip redundant root signature changes.
+	std::mutex RootSignatureCacheLock;
+	std::unordered_map<ID3D12Device *, std::unordered_map<ShaderDigest::Hash, CComPtr<ID3D12RootSignature>, ShaderDigest::Hasher>>
+		RootSignatureCache;
+
+	CComPtr<ID3D12RootSignature> GetOrCreateRootSignature(
+		ID3D12Device2 *Device,
+		const D3D12_SHADER_BYTECODE& Bytecode,
+		uint64_t TechniqueId)
+	{
+		const auto digest = ShaderDigest::Compute(Bytecode.pShaderBytecode, Bytecode.BytecodeLength);
+
+		{
+			std::scoped_lock lock(RootSignatureCacheLock);
+			auto& deviceCache = RootSignatureCache[Device];
+
+			if (auto itr = deviceCache.find(digest); itr != deviceCache.end())
+				return itr->second;
+		}
+
+		CComPtr<ID3D12RootSignature> newSignature;
+		const auto hr = Device->CreateRootSignature(0, Bytecode.pShaderBytecode, Bytecode.BytecodeLength, IID_PPV_ARGS(&newSignature));
+
+		if (FAILED(hr))
+		{
+			// Somebody passed in malformed data
+			spdlog::error("Failed to create root signature: {:X}. Shader technique: {:X}.", static_cast<uint32_t>(hr), TechniqueId);
+			return nullptr;
+		}
+
+		// Lets pipeline fingerprints identify the signature across game launches
+		newSignature->SetPrivateData(D3DPipelineStateStream::IID_RootSignatureDigest, sizeof(digest), &digest);
+
+		// Another thread might've created the same signature in the meantime. The first one wins.
+		std::scoped_lock lock(RootSignatureCacheLock);
+		return RootSignatureCache[Device].try_emplace(digest, std::move(newSignature)).first->second;
+	}
+
 	bool PatchPipelineStateStream(
 		D3DPipelineStateStream::Copy& StreamCopy,
 		ID3D12Device2 *Device,
 		const std::span<const uint8_t> *RootSignatureData,
 		const char *TechniqueName,
-		uint64_t TechniqueId)
+		uint64_t TechniqueId,
+		std::span<const ResolvedShader> ResolvedShaders)
 	{
-		bool modified = false;
+		bool shadersModified = false;
+		bool rootSignatureModified = false;
+		PatchedShader shaders[8];
+		size_t shaderCount = 0;
+		const D3D12_INPUT_LAYOUT_DESC *inputLayout = nullptr;
 
 		for (D3DPipelineStateStream::Iterator iter(StreamCopy.GetDesc()); !iter.AtEnd(); iter.Advance())
 		{
@@ -164,8 +517,33 @@ namespace D3DShaderReplacement
 			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CS:
 			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_AS:
 			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_MS:
-				if (ExtractOrReplaceShader(StreamCopy, obj->Type, &obj->Shader, TechniqueName, TechniqueId))
-					modified = true;
+			{
+				const auto original = obj->Shader;
+				const bool replaced = ExtractOrReplaceShader(
+					StreamCopy,
+					obj->Type,
+					&obj->Shader,
+					TechniqueName,
+					TechniqueId,
+					ResolvedShaders);
+
+				if (shaderCount < std::size(shaders))
+				{
+					shaders[shaderCount++] = {
+						.Type = obj->Type,
+						.Bytecode = &obj->Shader,
+						.Original = original,
+						.Replaced = replaced,
+					};
+				}
+
+				if (replaced)
+					shadersModified = true;
+			}
+			break;
+
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT:
+				inputLayout = &obj->InputLayout;
 				break;
 
 			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE:
@@ -176,29 +554,14 @@ namespace D3DShaderReplacement
 						.BytecodeLength = RootSignatureData->size(),
 					};
 
-					if (ExtractOrReplaceShader(StreamCopy, obj->Type, &bytecode, TechniqueName, TechniqueId))
+					if (ExtractOrReplaceShader(StreamCopy, obj->Type, &bytecode, TechniqueName, TechniqueId, ResolvedShaders))
 					{
-						CComPtr<ID3D12RootSignature> newSignature;
-						const auto hr = Device->CreateRootSignature(
-							0,
-							bytecode.pShaderBytecode,
-							bytecode.BytecodeLength,
-							IID_PPV_ARGS(&newSignature));
-
-						if (FAILED(hr))
-						{
-							// Somebody passed in malformed data
-							spdlog::error(
-								"Failed to create root signature: {:X}. Shader technique: {:X}.",
-								static_cast<uint32_t>(hr),
-								TechniqueId);
-						}
-						else
+						if (auto newSignature = GetOrCreateRootSignature(Device, bytecode, TechniqueId))
 						{
 							obj->RootSignature = newSignature.Get();
 							StreamCopy.TrackObject(std::move(newSignature));
 
-							modified = true;
+							rootSignatureModified = true;
 						}
 					}
 				}
@@ -206,6 +569,25 @@ namespace D3DShaderReplacement
 			}
 		}
 
+		// Replacements can read values the other stages don't provide. All of them are dropped in that case since
+		// there's no telling which one is at fault.
+		if (shadersModified && Plugin::ValidateCustomShaders)
+		{
+			std::string error;
+
+			if (!IsLinkageValid({ shaders, shaderCount }, inputLayout, error))
+			{
+				spdlog::error("Skipping custom shaders for technique {:X} ({}): {}.", TechniqueId, TechniqueName, error);
+
+				for (size_t i = 0; i < shaderCount; i++)
+					*shaders[i].Bytecode = shaders[i].Original;
+
+				shadersModified = false;
+			}
+		}
+
+		const bool modified = shadersModified || rootSignatureModified;
+
 		// Loop around once again to disable PSO cache entries
 		if (modified)
 		{
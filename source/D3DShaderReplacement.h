@@ -1,15 +1,33 @@
 #pragma once
 
+#include <future>
 #include "D3DPipelineStateStream.h"
+#include "ShaderBlobCache.h"
 
 namespace D3DShaderReplacement
 {
+	void Initialize();
 	const std::filesystem::path& GetShaderBinDirectory();
+	const std::vector<std::filesystem::path>& GetShaderBinDirectories();
+	const char *GetShaderTypePrefix(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type);
+	void GetTechniqueShortName(const char *TechniqueName, char (&Output)[512]);
+	ShaderDigest::Hash GetOriginalContainerDigest(const ShaderDigest::Hash& Digest);
+	bool RequiresTechniqueIds();
+
+	// A custom shader that was loaded ahead of pipeline creation along with the index entry it was loaded from
+	struct ResolvedShader
+	{
+		ShaderBinIndex::Entry File;
+		ShaderBlobCache::Entry Blob;
+	};
+
+	std::future<std::vector<ResolvedShader>> ResolveTechniqueAsync(const char *TechniqueName, uint64_t TechniqueId);
 
 	bool PatchPipelineStateStream(
 		D3DPipelineStateStream::Copy& StreamCopy,
 		ID3D12Device2 *Device,
 		const std::span<const uint8_t> *RootSignatureData,
 		const char *TechniqueName,
-		uint64_t TechniqueId);
+		uint64_t TechniqueId,
+		std::span<const ResolvedShader> ResolvedShaders);
 }
@@ -0,0 +1,564 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ShaderDigest.h"
+
+//
+// DXBC/DXIL container helpers. Shader bytecode and serialized root signatures share the same container format:
+//
+// [Header]
+// [uint32_t PartOffsets * PartCount]
+// [Parts]               Each part starts with a FourCC and a size
+//
+// This header has no platform dependencies and is shared with the command line tools.
+//
+namespace DXContainer
+{
+	constexpr uint32_t Magic = 0x43425844; // "DXBC"
+
+	struct Header
+	{
+		uint32_t Magic;
+		uint8_t Digest[16];
+		uint16_t MajorVersion;
+		uint16_t MinorVersion;
+		uint32_t ContainerSize;
+		uint32_t PartCount;
+	};
+	static_assert(sizeof(Header) == 32);
+
+	// The digest is stored as a ShaderDigest::Hash so that it can share hash map code. Its string form keeps the
+	// original byte order.
+	inline std::optional<ShaderDigest::Hash> GetDigest(const void *Data, size_t Size)
+	{
+		if (!Data || Size < sizeof(Header))
+			return std::nullopt;
+
+		Header header;
+		memcpy(&header, Data, sizeof(header));
+
+		if (header.Magic != Magic)
+			return std::nullopt;
+
+		ShaderDigest::Hash digest;
+		memcpy(&digest.Low, header.Digest, 8);
+		memcpy(&digest.High, header.Digest + 8, 8);
+
+		// Unsigned containers have an all zero digest. It can't identify anything.
+		if (digest.IsZero())
+			return std::nullopt;
+
+		return digest;
+	}
+
+	inline std::string DigestToString(const ShaderDigest::Hash& Digest)
+	{
+		uint8_t bytes[16];
+		memcpy(bytes, &Digest.Low, 8);
+		memcpy(bytes + 8, &Digest.High, 8);
+
+		std::string output;
+
+		for (const auto b : bytes)
+		{
+			constexpr char digits[] = "0123456789ABCDEF";
+			output.push_back(digits[b >> 4]);
+			output.push_back(digits[b & 0xF]);
+		}
+
+		return output;
+	}
+
+	inline std::optional<ShaderDigest::Hash> DigestFromString(std::string_view Text)
+	{
+		auto fromHex = [](char C) -> int
+		{
+			if (C >= '0' && C <= '9')
+				return C - '0';
+
+			if (C >= 'a' && C <= 'f')
+				return C - 'a' + 10;
+
+			if (C >= 'A' && C <= 'F')
+				return C - 'A' + 10;
+
+			return -1;
+		};
+
+		if (Text.size() != 32)
+			return std::nullopt;
+
+		uint8_t bytes[16];
+
+		for (size_t i = 0; i < std::size(bytes); i++)
+		{
+			const auto high = fromHex(Text[i * 2]);
+			const auto low = fromHex(Text[i * 2 + 1]);
+
+			if (high < 0 || low < 0)
+				return std::nullopt;
+
+			bytes[i] = static_cast<uint8_t>((high << 4) | low);
+		}
+
+		ShaderDigest::Hash digest;
+		memcpy(&digest.Low, bytes, 8);
+		memcpy(&digest.High, bytes + 8, 8);
+
+		return digest;
+	}
+
+	constexpr uint32_t MakeFourCC(char A, char B, char C, char D)
+	{
+		return static_cast<uint32_t>(static_cast<uint8_t>(A)) | (static_cast<uint32_t>(static_cast<uint8_t>(B)) << 8) |
+			   (static_cast<uint32_t>(static_cast<uint8_t>(C)) << 16) | (static_cast<uint32_t>(static_cast<uint8_t>(D)) << 24);
+	}
+
+	struct Part
+	{
+		uint32_t FourCC = 0;
+		std::span<const uint8_t> Data; // Excludes the part header
+	};
+
+	struct Container
+	{
+		ShaderDigest::Hash Digest;
+		std::vector<Part> Parts;
+
+		const Part *FindPart(std::initializer_list<uint32_t> FourCCs) const
+		{
+			for (const auto& part : Parts)
+			{
+				if (std::find(FourCCs.begin(), FourCCs.end(), part.FourCC) != FourCCs.end())
+					return &part;
+			}
+
+			return nullptr;
+		}
+	};
+
+	template<typename T>
+	bool ReadValue(std::span<const uint8_t> Data, uint64_t Offset, T& Output)
+	{
+		if (Offset > Data.size() || sizeof(T) > Data.size() - Offset)
+			return false;
+
+		memcpy(&Output, Data.data() + Offset, sizeof(T));
+		return true;
+	}
+
+	inline std::optional<Container> Parse(std::span<const uint8_t> Data, std::string& Error)
+	{
+		Header header;
+
+		if (!ReadValue(Data, 0, header) || header.Magic != Magic)
+		{
+			Error = "not a DXBC/DXIL container";
+			return std::nullopt;
+		}
+
+		if (header.MajorVersion != 1 || header.MinorVersion != 0)
+		{
+			Error = "unsupported container version";
+			return std::nullopt;
+		}
+
+		if (header.ContainerSize != Data.size())
+		{
+			Error = "container size doesn't match the file size";
+			return std::nullopt;
+		}
+
+		Container container;
+		memcpy(&container.Digest.Low, header.Digest, 8);
+		memcpy(&container.Digest.High, header.Digest + 8, 8);
+
+		for (uint32_t i = 0; i < header.PartCount; i++)
+		{
+			uint32_t partOffset = 0;
+			uint32_t partHeader[2] = {}; // FourCC, size
+
+			if (!ReadValue(Data, sizeof(Header) + i * sizeof(uint32_t), partOffset) || !ReadValue(Data, partOffset, partHeader) ||
+				partHeader[1] > Data.size() - partOffset - sizeof(partHeader))
+			{
+				Error = "part table is out of bounds";
+				return std::nullopt;
+			}
+
+			container.Parts.emplace_back(partHeader[0], Data.subspan(partOffset + sizeof(partHeader), partHeader[1]));
+		}
+
+		return container;
+	}
+
+	namespace Detail
+	{
+		inline void MD5Transform(uint32_t (&State)[4], const uint8_t *Block)
+		{
+			constexpr uint32_t constants[64] = {
+				0xD76AA478, 0xE8C7B756, 0x242070DB, 0xC1BDCEEE, 0xF57C0FAF, 0x4787C62A, 0xA8304613, 0xFD469501,
+				0x698098D8, 0x8B44F7AF, 0xFFFF5BB1, 0x895CD7BE, 0x6B901122, 0xFD987193, 0xA679438E, 0x49B40821,
+				0xF61E2562, 0xC040B340, 0x265E5A51, 0xE9B6C7AA, 0xD62F105D, 0x02441453, 0xD8A1E681, 0xE7D3FBC8,
+				0x21E1CDE6, 0xC33707D6, 0xF4D50D87, 0x455A14ED, 0xA9E3E905, 0xFCEFA3F8, 0x676F02D9, 0x8D2A4C8A,
+				0xFFFA3942, 0x8771F681, 0x6D9D6122, 0xFDE5380C, 0xA4BEEA44, 0x4BDECFA9, 0xF6BB4B60, 0xBEBFBC70,
+				0x289B7EC6, 0xEAA127FA, 0xD4EF3085, 0x04881D05, 0xD9D4D039, 0xE6DB99E5, 0x1FA27CF8, 0xC4AC5665,
+				0xF4292244, 0x432AFF97, 0xAB9423A7, 0xFC93A039, 0x655B59C3, 0x8F0CCC92, 0xFFEFF47D, 0x85845DD1,
+				0x6FA87E4F, 0xFE2CE6E0, 0xA3014314, 0x4E0811A1, 0xF7537E82, 0xBD3AF235, 0x2AD7D2BB, 0xEB86D391,
+			};
+
+			constexpr uint32_t shifts[16] = { 7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21 };
+
+			uint32_t words[16];
+			memcpy(words, Block, sizeof(words));
+
+			uint32_t a = State[0];
+			uint32_t b = State[1];
+			uint32_t c = State[2];
+			uint32_t d = State[3];
+
+			for (uint32_t i = 0; i < 64; i++)
+			{
+				uint32_t f;
+				uint32_t g;
+
+				if (i < 16)
+				{
+					f = (b & c) | (~b & d);
+					g = i;
+				}
+				else if (i < 32)
+				{
+					f = (d & b) | (~d & c);
+					g = (5 * i + 1) % 16;
+				}
+				else if (i < 48)
+				{
+					f = b ^ c ^ d;
+					g = (3 * i + 5) % 16;
+				}
+				else
+				{
+					f = c ^ (b | ~d);
+					g = (7 * i) % 16;
+				}
+
+				f += a + constants[i] + words[g];
+				a = d;
+				d = c;
+				c = b;
+				b += std::rotl(f, static_cast<int>(shifts[(i / 16) * 4 + i % 4]));
+			}
+
+			State[0] += a;
+			State[1] += b;
+			State[2] += c;
+			State[3] += d;
+		}
+	}
+
+	//
+	// The digest the shader compilers and the DXIL validator write into the header. It's MD5 over everything after
+	// the digest with a nonstandard final block: the bit count comes first and a second length word comes last.
+	//
+	inline ShaderDigest::Hash ComputeRetailDigest(std::span<const uint8_t> Data)
+	{
+		constexpr size_t skippedBytes = offsetof(Header, MajorVersion);
+
+		if (Data.size() < skippedBytes)
+			return {};
+
+		const auto data = Data.subspan(skippedBytes);
+		const size_t fullBlockBytes = data.size() & ~size_t(63);
+		const size_t remainder = data.size() - fullBlockBytes;
+		const uint32_t bitCount = static_cast<uint32_t>(data.size() * 8);
+		const uint32_t trailer = (bitCount >> 2) | 1;
+
+		uint32_t state[4] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476 };
+		uint8_t block[64] = {};
+
+		for (size_t i = 0; i < fullBlockBytes; i += 64)
+			Detail::MD5Transform(state, data.data() + i);
+
+		if (remainder >= 56)
+		{
+			// No room for the length words. They get a block of their own.
+			memcpy(block, data.data() + fullBlockBytes, remainder);
+			block[remainder] = 0x80;
+			Detail::MD5Transform(state, block);
+
+			memset(block, 0, sizeof(block));
+			memcpy(block, &bitCount, sizeof(bitCount));
+			memcpy(block + 60, &trailer, sizeof(trailer));
+		}
+		else
+		{
+			memcpy(block, &bitCount, sizeof(bitCount));
+			memcpy(block + 4, data.data() + fullBlockBytes, remainder);
+			block[4 + remainder] = 0x80;
+			memcpy(block + 60, &trailer, sizeof(trailer));
+		}
+
+		Detail::MD5Transform(state, block);
+
+		ShaderDigest::Hash digest;
+		memcpy(&digest.Low, &state[0], 8);
+		memcpy(&digest.High, &state[2], 8);
+
+		return digest;
+	}
+
+	inline bool IsNonRuntimePart(uint32_t FourCC)
+	{
+		// Debug info, PDBs, embedded source, reflection statistics, and user data. Drivers never look at them.
+		switch (FourCC)
+		{
+		case MakeFourCC('I', 'L', 'D', 'B'):
+		case MakeFourCC('I', 'L', 'D', 'N'):
+		case MakeFourCC('S', 'R', 'C', 'I'):
+		case MakeFourCC('S', 'T', 'A', 'T'):
+		case MakeFourCC('P', 'R', 'I', 'V'):
+		case MakeFourCC('S', 'P', 'D', 'B'):
+		case MakeFourCC('S', 'D', 'B', 'G'):
+			return true;
+		}
+
+		return false;
+	}
+
+	//
+	// Rebuilds the container without non-runtime parts and signs it again. Returns nothing when there's nothing to
+	// strip or when the container wasn't signed with the retail digest, since re-signing those would hide problems
+	// the runtime is supposed to catch.
+	//
+	inline std::optional<std::vector<uint8_t>> StripNonRuntimeParts(std::span<const uint8_t> Data)
+	{
+		std::string error;
+		const auto container = Parse(Data, error);
+
+		if (!container || container->Digest.IsZero())
+			return std::nullopt;
+
+		if (std::none_of(
+				container->Parts.begin(),
+				container->Parts.end(),
+				[](const Part& P)
+				{
+					return IsNonRuntimePart(P.FourCC);
+				}))
+			return std::nullopt;
+
+		if (ComputeRetailDigest(Data) != container->Digest)
+			return std::nullopt;
+
+		constexpr size_t partHeaderSize = 8;
+		std::vector<const Part *> keptParts;
+		size_t outputSize = sizeof(Header);
+
+		for (const auto& part : container->Parts)
+		{
+			if (IsNonRuntimePart(part.FourCC))
+				continue;
+
+			keptParts.emplace_back(&part);
+			outputSize += sizeof(uint32_t) + partHeaderSize + part.Data.size();
+		}
+
+		std::vector<uint8_t> output(outputSize);
+		size_t partOffset = sizeof(Header) + keptParts.size() * sizeof(uint32_t);
+
+		for (size_t i = 0; i < keptParts.size(); i++)
+		{
+			// Copies the part header along with the data
+			const auto part = keptParts[i];
+			const auto offset = static_cast<uint32_t>(partOffset);
+
+			memcpy(output.data() + sizeof(Header) + i * sizeof(uint32_t), &offset, sizeof(offset));
+			memcpy(output.data() + partOffset, part->Data.data() - partHeaderSize, partHeaderSize + part->Data.size());
+			partOffset += partHeaderSize + part->Data.size();
+		}
+
+		Header header;
+		memcpy(&header, Data.data(), sizeof(header));
+		header.ContainerSize = static_cast<uint32_t>(output.size());
+		header.PartCount = static_cast<uint32_t>(keptParts.size());
+		memcpy(output.data(), &header, sizeof(header));
+
+		const auto digest = ComputeRetailDigest(output);
+		memcpy(output.data() + offsetof(Header, Digest), &digest.Low, 8);
+		memcpy(output.data() + offsetof(Header, Digest) + 8, &digest.High, 8);
+
+		return output;
+	}
+
+	//
+	// Input, output, and patch constant signatures. DXBC uses ISGN/OSGN/OSG5/PCSG while DXIL uses ISG1/OSG1/PSG1.
+	//
+	struct SignatureElement
+	{
+		std::string_view SemanticName;
+		uint32_t SemanticIndex = 0;
+		uint32_t SystemValue = 0; // D3D_NAME
+		uint32_t ComponentType = 0;
+		uint32_t Register = 0;
+		uint32_t Stream = 0;
+		uint8_t Mask = 0;
+	};
+
+	inline bool ParseSignature(const Part& SignaturePart, std::vector<SignatureElement>& Output)
+	{
+		// Element layouts only differ in a leading stream index and a trailing min precision field
+		const bool hasStream = SignaturePart.FourCC == MakeFourCC('O', 'S', 'G', '5') || SignaturePart.FourCC == MakeFourCC('I', 'S', 'G', '1') ||
+							   SignaturePart.FourCC == MakeFourCC('O', 'S', 'G', '1') || SignaturePart.FourCC == MakeFourCC('P', 'S', 'G', '1');
+		const bool hasMinPrecision = SignaturePart.FourCC == MakeFourCC('I', 'S', 'G', '1') ||
+									 SignaturePart.FourCC == MakeFourCC('O', 'S', 'G', '1') ||
+									 SignaturePart.FourCC == MakeFourCC('P', 'S', 'G', '1');
+		const uint32_t elementSize = 24 + (hasStream ? 4 : 0) + (hasMinPrecision ? 4 : 0);
+
+		const auto data = SignaturePart.Data;
+		uint32_t elementCount = 0;
+		uint32_t elementOffset = 0;
+
+		if (!ReadValue(data, 0, elementCount) || !ReadValue(data, 4, elementOffset))
+			return false;
+
+		for (uint32_t i = 0; i < elementCount; i++)
+		{
+			const uint64_t base = elementOffset + static_cast<uint64_t>(i) * elementSize;
+			uint64_t offset = base;
+			SignatureElement element;
+			uint32_t nameOffset = 0;
+
+			if (hasStream && !ReadValue(data, base, element.Stream))
+				return false;
+
+			offset += hasStream ? 4 : 0;
+
+			if (!ReadValue(data, offset + 0, nameOffset) || !ReadValue(data, offset + 4, element.SemanticIndex) ||
+				!ReadValue(data, offset + 8, element.SystemValue) || !ReadValue(data, offset + 12, element.ComponentType) ||
+				!ReadValue(data, offset + 16, element.Register) || !ReadValue(data, offset + 20, element.Mask))
+				return false;
+
+			// Names are null terminated and relative to the start of the part
+			if (nameOffset >= data.size())
+				return false;
+
+			const auto nameStart = reinterpret_cast<const char *>(data.data() + nameOffset);
+			const auto nameEnd = static_cast<const char *>(memchr(nameStart, '\0', data.size() - nameOffset));
+
+			if (!nameEnd)
+				return false;
+
+			element.SemanticName = std::string_view(nameStart, nameEnd);
+			Output.emplace_back(element);
+		}
+
+		return true;
+	}
+
+	inline bool SemanticNamesEqual(std::string_view A, std::string_view B)
+	{
+		return A.size() == B.size() && std::equal(
+										   A.begin(),
+										   A.end(),
+										   B.begin(),
+										   [](char X, char Y)
+										   {
+											   return (X | 0x20) == (Y | 0x20);
+										   });
+	}
+
+	inline const SignatureElement *FindElement(const std::vector<SignatureElement>& Elements, const SignatureElement& Element)
+	{
+		for (const auto& e : Elements)
+		{
+			if (e.SemanticIndex == Element.SemanticIndex && e.Stream == Element.Stream && SemanticNamesEqual(e.SemanticName, Element.SemanticName))
+				return &e;
+		}
+
+		return nullptr;
+	}
+
+	inline std::optional<std::vector<SignatureElement>> FindSignature(const Container& Shader, std::initializer_list<uint32_t> FourCCs)
+	{
+		// Missing or malformed signatures can't be checked and are reported as nothing
+		const auto part = Shader.FindPart(FourCCs);
+		std::vector<SignatureElement> elements;
+
+		if (!part || !ParseSignature(*part, elements))
+			return std::nullopt;
+
+		return elements;
+	}
+
+	inline std::optional<std::vector<SignatureElement>> GetInputSignature(const Container& Shader)
+	{
+		return FindSignature(Shader, { MakeFourCC('I', 'S', 'G', '1'), MakeFourCC('I', 'S', 'G', 'N') });
+	}
+
+	inline std::optional<std::vector<SignatureElement>> GetOutputSignature(const Container& Shader)
+	{
+		auto outputs =
+			FindSignature(Shader, { MakeFourCC('O', 'S', 'G', '1'), MakeFourCC('O', 'S', 'G', '5'), MakeFourCC('O', 'S', 'G', 'N') });
+
+		// Hull shader patch constants and mesh shader per-primitive attributes live in a signature of their own
+		if (auto extra = FindSignature(Shader, { MakeFourCC('P', 'S', 'G', '1'), MakeFourCC('P', 'C', 'S', 'G') }); outputs && extra)
+			outputs->insert(outputs->end(), extra->begin(), extra->end());
+
+		return outputs;
+	}
+
+	//
+	// Pipeline creation fails when a stage reads a user defined value that nothing before it provides. System values
+	// are either generated by the pipeline or validated by the runtime itself. Packing isn't compared since stages
+	// are linked by semantic.
+	//
+	inline bool AreInputsProvided(
+		const std::vector<SignatureElement>& Inputs,
+		const std::vector<SignatureElement>& Provided,
+		const char *ProviderName,
+		std::string& Error)
+	{
+		for (const auto& element : Inputs)
+		{
+			if (element.SystemValue != 0 || FindElement(Provided, element))
+				continue;
+
+			Error = "input " + std::string(element.SemanticName) + std::to_string(element.SemanticIndex) + " isn't provided by " +
+					ProviderName;
+			return false;
+		}
+
+		return true;
+	}
+
+	//
+	// Checks whether Replacement can be handed to the runtime in place of another shader. It's free to read and write
+	// different values than the original as long as the rest of the pipeline agrees, which is checked with
+	// AreInputsProvided once every stage is known. The container needs a digest since unsigned shaders are rejected
+	// by the runtime.
+	//
+	inline bool IsCompatibleReplacement(std::span<const uint8_t> Replacement, std::string& Error)
+	{
+		const auto replacement = Parse(Replacement, Error);
+
+		if (!replacement)
+			return false;
+
+		if (replacement->Digest.IsZero())
+		{
+			Error = "container isn't signed (digest is zero)";
+			return false;
+		}
+
+		return true;
+	}
+}
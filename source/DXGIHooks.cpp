@@ -0,0 +1,161 @@
+#include <dxgi1_4.h>
+#include "CComPtr.h"
+#include "CRHooks.h"
+#include "DXGIHooks.h"
+#include "HitchMonitor.h"
+
+namespace DXGIHooks
+{
+	//
+	// Swap chain presents mark frame boundaries for the hitch monitor and for live updates.
+	//
+	// The game's factory creation is redirected through its import table, which is the earliest point where DXGI
+	// objects can be intercepted without creating any of our own during startup.
+	//
+	HRESULT(WINAPI *DXGICreateFactory1)(REFIID, void **);
+	HRESULT(WINAPI *DXGICreateFactory2)(UINT, REFIID, void **);
+	HRESULT(WINAPI *DXGIFactoryCreateSwapChainForHwnd)(
+		IDXGIFactory2 *,
+		IUnknown *,
+		HWND,
+		const DXGI_SWAP_CHAIN_DESC1 *,
+		const DXGI_SWAP_CHAIN_FULLSCREEN_DESC *,
+		IDXGIOutput *,
+		IDXGISwapChain1 **);
+	HRESULT(WINAPI *DXGISwapChainPresent)(IDXGISwapChain *, UINT, UINT);
+	HRESULT(WINAPI *DXGISwapChainPresent1)(IDXGISwapChain1 *, UINT, UINT, const DXGI_PRESENT_PARAMETERS *);
+
+	std::atomic_bool PresentHooked;
+
+	void OnPresent()
+	{
+		HitchMonitor::OnPresent();
+		CRHooks::OnPresent();
+	}
+
+	HRESULT WINAPI HookedDXGISwapChainPresent(IDXGISwapChain *This, UINT SyncInterval, UINT Flags)
+	{
+		const auto hr = DXGISwapChainPresent(This, SyncInterval, Flags);
+
+		if ((Flags & DXGI_PRESENT_TEST) == 0)
+			OnPresent();
+
+		return hr;
+	}
+
+	HRESULT WINAPI HookedDXGISwapChainPresent1(
+		IDXGISwapChain1 *This,
+		UINT SyncInterval,
+		UINT Flags,
+		const DXGI_PRESENT_PARAMETERS *PresentParameters)
+	{
+		const auto hr = DXGISwapChainPresent1(This, SyncInterval, Flags, PresentParameters);
+
+		if ((Flags & DXGI_PRESENT_TEST) == 0)
+			OnPresent();
+
+		return hr;
+	}
+
+	HRESULT WINAPI HookedDXGIFactoryCreateSwapChainForHwnd(
+		IDXGIFactory2 *This,
+		IUnknown *Device,
+		HWND Window,
+		const DXGI_SWAP_CHAIN_DESC1 *Desc,
+		const DXGI_SWAP_CHAIN_FULLSCREEN_DESC *FullscreenDesc,
+		IDXGIOutput *RestrictToOutput,
+		IDXGISwapChain1 **SwapChain)
+	{
+		const auto hr = DXGIFactoryCreateSwapChainForHwnd(This, Device, Window, Desc, FullscreenDesc, RestrictToOutput, SwapChain);
+
+		if (SUCCEEDED(hr))
+		{
+			// Every swap chain shares the same vtable
+			static bool once = [&]
+			{
+				const auto vtableBase = *reinterpret_cast<uintptr_t *>(*SwapChain);
+
+				const bool hooked = Hooks::WriteVirtualFunction(vtableBase, 8, &HookedDXGISwapChainPresent, &DXGISwapChainPresent);
+				const bool hooked1 = Hooks::WriteVirtualFunction(vtableBase, 22, &HookedDXGISwapChainPresent1, &DXGISwapChainPresent1);
+
+				PresentHooked = hooked || hooked1;
+
+				if (PresentHooked)
+					spdlog::info("Hooked swap chain presents.");
+				else
+					spdlog::error("Failed to hook swap chain presents.");
+
+				return true;
+			}();
+		}
+
+		return hr;
+	}
+
+	void HookFactory(void *Factory)
+	{
+		CComPtr<IDXGIFactory2> factory2;
+
+		if (FAILED(static_cast<IUnknown *>(Factory)->QueryInterface(IID_PPV_ARGS(&factory2))))
+			return;
+
+		static bool once = [&]
+		{
+			const auto vtableBase = *reinterpret_cast<uintptr_t *>(factory2.Get());
+
+			return Hooks::WriteVirtualFunction(
+				vtableBase,
+				15,
+				&HookedDXGIFactoryCreateSwapChainForHwnd,
+				&DXGIFactoryCreateSwapChainForHwnd);
+		}();
+	}
+
+	HRESULT WINAPI HookedCreateDXGIFactory1(REFIID Riid, void **Factory)
+	{
+		const auto hr = DXGICreateFactory1(Riid, Factory);
+
+		if (SUCCEEDED(hr))
+			HookFactory(*Factory);
+
+		return hr;
+	}
+
+	HRESULT WINAPI HookedCreateDXGIFactory2(UINT Flags, REFIID Riid, void **Factory)
+	{
+		const auto hr = DXGICreateFactory2(Flags, Riid, Factory);
+
+		if (SUCCEEDED(hr))
+			HookFactory(*Factory);
+
+		return hr;
+	}
+
+	DECLARE_HOOK_TRANSACTION(DXGIHooks)
+	{
+		if (!HitchMonitor::IsEnabled() && !CRHooks::RequiresPresentNotifications())
+			return;
+
+		// The game may import either one
+		const bool hooked1 = Hooks::RedirectImport(
+			nullptr,
+			"dxgi.dll",
+			"CreateDXGIFactory1",
+			reinterpret_cast<const void *>(&HookedCreateDXGIFactory1),
+			reinterpret_cast<void **>(&DXGICreateFactory1));
+		const bool hooked2 = Hooks::RedirectImport(
+			nullptr,
+			"dxgi.dll",
+			"CreateDXGIFactory2",
+			reinterpret_cast<const void *>(&HookedCreateDXGIFactory2),
+			reinterpret_cast<void **>(&DXGICreateFactory2));
+
+		if (!hooked1 && !hooked2)
+			spdlog::error("The game doesn't import a DXGI factory function. Swap chain presents can't be tracked.");
+	};
+
+	bool IsPresentHooked()
+	{
+		return PresentHooked;
+	}
+}
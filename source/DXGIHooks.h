@@ -0,0 +1,6 @@
+#pragma once
+
+namespace DXGIHooks
+{
+	bool IsPresentHooked();
+}
@@ -0,0 +1,155 @@
+#include "HitchMonitor.h"
+#include "Plugin.h"
+#include "TopList.h"
+
+namespace HitchMonitor
+{
+	//
+	// Pipelines created during gameplay stall the frame that needs them. Frames are delimited by swap chain
+	// presents. Pipeline creations and live update swaps are collected per frame and listed whenever a frame takes
+	// longer than the configured threshold.
+	//
+	struct FrameEvent
+	{
+		uint64_t TechniqueId = 0;
+		const char *TechniqueName = nullptr;
+		uint32_t Duration = 0; // Microseconds
+		PipelineTelemetry::PipelineSource Source = PipelineTelemetry::PipelineSource::Compiled;
+		bool Patched = false;
+		bool LiveUpdate = false;
+	};
+
+	// Loading screens create thousands of pipelines per frame. Only the slowest are listed.
+	constexpr size_t MaxEventsPerFrame = 4096;
+	constexpr size_t MaxReportedEvents = 10;
+
+	std::mutex FrameEventsLock;
+	std::vector<FrameEvent> FrameEvents;
+	size_t DiscardedFrameEvents = 0;
+
+	std::optional<std::chrono::steady_clock::time_point> LastPresentTime;
+	uint64_t FrameIndex = 0;
+
+	void AddEvent(const FrameEvent& Event)
+	{
+		std::scoped_lock lock(FrameEventsLock);
+
+		if (FrameEvents.size() < MaxEventsPerFrame)
+			FrameEvents.emplace_back(Event);
+		else
+			DiscardedFrameEvents++;
+	}
+
+	void ReportHitch(double FrameTime, std::vector<FrameEvent>& Events, size_t DiscardedEvents)
+	{
+		uint64_t totalTime = 0;
+		size_t patchedCount = 0;
+
+		for (const auto& event : Events)
+		{
+			totalTime += event.Duration;
+			patchedCount += event.Patched ? 1 : 0;
+		}
+
+		spdlog::warn(
+			"Hitch: Frame {} took {:.1f} ms. {} pipeline(s) were created or swapped in {:.1f} ms, {} with custom shaders.",
+			FrameIndex,
+			FrameTime,
+			Events.size() + DiscardedEvents,
+			totalTime / 1000.0,
+			patchedCount);
+
+		const auto slowest = TopList::SelectLargest(
+			std::span(Events),
+			MaxReportedEvents,
+			[](const FrameEvent& Event)
+			{
+				return Event.Duration;
+			});
+
+		for (const auto& event : slowest)
+		{
+			const char *origin = "compiled";
+
+			if (event.LiveUpdate)
+				origin = "live update";
+			else if (event.Source == PipelineTelemetry::PipelineSource::GameLibrary ||
+					 event.Source == PipelineTelemetry::PipelineSource::PatchedLibrary)
+				origin = "pipeline library";
+			else if (event.Source == PipelineTelemetry::PipelineSource::Prewarmed)
+				origin = "prewarmed";
+			else if (event.Source == PipelineTelemetry::PipelineSource::Shared)
+				origin = "shared";
+
+			spdlog::warn(
+				"Hitch:   {} ({:X}){}: {:.1f} ms, {}.",
+				event.TechniqueName ? event.TechniqueName : "",
+				event.TechniqueId,
+				event.Patched ? " [replaced]" : "",
+				event.Duration / 1000.0,
+				origin);
+		}
+	}
+
+	void OnPresent()
+	{
+		if (!IsEnabled())
+			return;
+
+		const auto now = std::chrono::steady_clock::now();
+		std::vector<FrameEvent> events;
+		size_t discardedEvents = 0;
+
+		{
+			std::scoped_lock lock(FrameEventsLock);
+
+			events.swap(FrameEvents);
+			std::swap(discardedEvents, DiscardedFrameEvents);
+		}
+
+		// Startup isn't a frame
+		if (LastPresentTime)
+		{
+			const auto frameTime = std::chrono::duration<double, std::milli>(now - *LastPresentTime).count();
+
+			if (frameTime >= Plugin::HitchThresholdMs && !events.empty())
+				ReportHitch(frameTime, events, discardedEvents);
+		}
+
+		LastPresentTime = now;
+		FrameIndex++;
+	}
+
+	bool IsEnabled()
+	{
+		return Plugin::HitchThresholdMs > 0;
+	}
+
+	void RecordPipeline(const PipelineTelemetry::Sample& Sample)
+	{
+		if (!IsEnabled())
+			return;
+
+		AddEvent({
+			.TechniqueId = Sample.TechniqueId,
+			.TechniqueName = Sample.TechniqueName,
+			.Duration = Sample.PatchTime + Sample.LibraryTime + Sample.CompileTime,
+			.Source = Sample.Source,
+			.Patched = Sample.Patched,
+		});
+	}
+
+	void RecordLiveUpdate(uint64_t TechniqueId, const char *TechniqueName, uint32_t CompileTime)
+	{
+		if (!IsEnabled())
+			return;
+
+		AddEvent({
+			.TechniqueId = TechniqueId,
+			.TechniqueName = TechniqueName,
+			.Duration = CompileTime,
+			.Patched = true,
+			.LiveUpdate = true,
+		});
+	}
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "PipelineTelemetry.h"
+
+namespace HitchMonitor
+{
+	bool IsEnabled();
+	void OnPresent();
+	void RecordPipeline(const PipelineTelemetry::Sample& Sample);
+	void RecordLiveUpdate(uint64_t TechniqueId, const char *TechniqueName, uint32_t CompileTime);
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "ShaderDigest.h"
+#include "ShaderPaths.h"
+
+//
+// Bookkeeping for live updates that doesn't touch the file system or D3D. This header has no platform dependencies
+// and is shared with the tests.
+//
+namespace LiveUpdateTracking
+{
+	// Editors tend to save in several steps (truncate, write, rename). Changes are collected until the directories
+	// have been quiet for this long.
+	constexpr std::chrono::milliseconds DebounceTime(250);
+
+	// Reverse index from what a custom shader file replaces to tracked pipeline indices. Entries are never removed,
+	// so indices stay valid.
+	class PipelineIndex
+	{
+	private:
+		std::vector<std::string> m_TechniqueShortNames; // Lowercase, one per index
+		std::unordered_map<uint64_t, std::vector<size_t>> m_IndicesByTechniqueId;
+		std::unordered_map<ShaderDigest::Hash, std::vector<size_t>, ShaderDigest::Hasher> m_IndicesByContainerDigest;
+
+	public:
+		size_t Add(std::string_view TechniqueShortName, uint64_t TechniqueId, std::span<const ShaderDigest::Hash> ContainerDigests)
+		{
+			const auto index = m_TechniqueShortNames.size();
+
+			// Non-ASCII names can't be matched. ClassifyPath ignores those files as well.
+			m_TechniqueShortNames.emplace_back(ShaderPaths::ToLowerAscii(TechniqueShortName).value_or(""));
+			m_IndicesByTechniqueId[TechniqueId].emplace_back(index);
+
+			for (const auto& digest : ContainerDigests)
+			{
+				auto& indices = m_IndicesByContainerDigest[digest];
+
+				// Pipelines can use the same shader in several stages
+				if (indices.empty() || indices.back() != index)
+					indices.emplace_back(index);
+			}
+
+			return index;
+		}
+
+		size_t GetCount() const
+		{
+			return m_TechniqueShortNames.size();
+		}
+
+		// Returns sorted, unique indices of every pipeline that has to be recreated
+		std::vector<size_t> Find(std::span<const ShaderPaths::PathTarget> Targets) const
+		{
+			std::vector<size_t> indices;
+
+			for (const auto& target : Targets)
+			{
+				switch (target.Type)
+				{
+				case ShaderPaths::PathTarget::Kind::Technique:
+					if (auto itr = m_IndicesByTechniqueId.find(target.TechniqueId); itr != m_IndicesByTechniqueId.end())
+					{
+						for (const auto index : itr->second)
+						{
+							if (m_TechniqueShortNames[index] == target.TechniqueShortName)
+								indices.emplace_back(index);
+						}
+					}
+					break;
+
+				case ShaderPaths::PathTarget::Kind::ContainerDigest:
+					if (auto itr = m_IndicesByContainerDigest.find(target.ContainerDigest); itr != m_IndicesByContainerDigest.end())
+						indices.insert(indices.end(), itr->second.begin(), itr->second.end());
+					break;
+
+				case ShaderPaths::PathTarget::Kind::Everything:
+					indices.resize(m_TechniqueShortNames.size());
+					std::iota(indices.begin(), indices.end(), 0);
+					return indices;
+
+				case ShaderPaths::PathTarget::Kind::Ignored:
+					break;
+				}
+			}
+
+			std::sort(indices.begin(), indices.end());
+			indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+			return indices;
+		}
+	};
+
+	// Coalesces bursts of directory notifications into a single batch. Time is passed in by the caller.
+	class ChangeBatcher
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+	private:
+		std::vector<ShaderPaths::PathTarget> m_Targets;
+		std::optional<Clock::time_point> m_LastChange;
+		bool m_ChangesLost = false;
+
+	public:
+		// Any notification restarts the quiet period, even when none of its files are custom shaders
+		void Add(std::span<const ShaderPaths::PathTarget> Targets, bool ChangesLost, Clock::time_point Now)
+		{
+			m_LastChange = Now;
+			m_ChangesLost |= ChangesLost;
+
+			for (const auto& target : Targets)
+			{
+				if (target.Type == ShaderPaths::PathTarget::Kind::Ignored)
+					continue;
+
+				if (std::find(m_Targets.begin(), m_Targets.end(), target) == m_Targets.end())
+					m_Targets.emplace_back(target);
+			}
+		}
+
+		bool HasLostChanges() const
+		{
+			return m_ChangesLost;
+		}
+
+		// Returns std::nullopt when nothing is pending and the caller can block indefinitely
+		std::optional<Clock::duration> GetWaitTime(Clock::time_point Now) const
+		{
+			if (!m_LastChange)
+				return std::nullopt;
+
+			return std::max(*m_LastChange + DebounceTime - Now, Clock::duration::zero());
+		}
+
+		bool IsReady(Clock::time_point Now) const
+		{
+			return m_LastChange && Now >= *m_LastChange + DebounceTime;
+		}
+
+		// Hands out the batch and starts a new one. Lost changes or a single bundle change affect everything.
+		std::vector<ShaderPaths::PathTarget> Take()
+		{
+			auto targets = std::move(m_Targets);
+			const bool everything = m_ChangesLost ||
+									std::any_of(
+										targets.begin(),
+										targets.end(),
+										[](const ShaderPaths::PathTarget& Target)
+										{
+											return Target.Type == ShaderPaths::PathTarget::Kind::Everything;
+										});
+
+			if (everything)
+			{
+				targets.clear();
+				targets.emplace_back(ShaderPaths::PathTarget { .Type = ShaderPaths::PathTarget::Kind::Everything });
+			}
+
+			m_Targets.clear();
+			m_LastChange.reset();
+			m_ChangesLost = false;
+
+			return targets;
+		}
+	};
+}
@@ -0,0 +1,380 @@
+#include <condition_variable>
+#include <shared_mutex>
+#include <dxgi1_4.h>
+#include "CComPtr.h"
+#include "PatchedPipelineLibrary.h"
+#include "Plugin.h"
+
+namespace PatchedPipelineLibrary
+{
+	//
+	// The game's pipeline library never sees modified pipelines since their streams don't match the vanilla ones.
+	// They're kept in a separate library next to the plugin instead. Pipeline names contain a fingerprint of the
+	// patched stream so that changed custom shaders or root signatures never match stale entries.
+	//
+	// The runtime rejects libraries created on other adapters or drivers. That's checked up front as well since
+	// the error codes vary between runtime versions.
+	//
+	// Entries can't be removed from a library. Pipelines for edited or deleted shaders would pile up across sessions,
+	// so the library is rebuilt from the pipelines this session used once loading has finished.
+	//
+	struct FileHeader
+	{
+		constexpr static uint32_t ExpectedMagic = 0x4C505053; // "SPPL"
+		constexpr static uint32_t ExpectedVersion = 2;
+
+		uint32_t Magic = ExpectedMagic;
+		uint32_t Version = ExpectedVersion;
+		uint32_t VendorId = 0;
+		uint32_t DeviceId = 0;
+		uint32_t SubSysId = 0;
+		uint32_t Revision = 0;
+		uint64_t DriverVersion = 0;
+		uint32_t PipelineCount = 0;
+		uint32_t Reserved = 0;
+
+		bool IsSameAdapter(const FileHeader& Other) const
+		{
+			return Magic == Other.Magic && Version == Other.Version && VendorId == Other.VendorId && DeviceId == Other.DeviceId &&
+				   SubSysId == Other.SubSysId && Revision == Other.Revision && DriverVersion == Other.DriverVersion;
+		}
+	};
+	static_assert(sizeof(FileHeader) == 40);
+
+	// Stale entries are tolerated up to this fraction of the library. Areas that weren't visited this session keep
+	// their pipelines.
+	constexpr size_t StalePipelineDivisor = 4;
+
+	// The library is only written after this long without new pipelines, i.e. once loading has finished
+	constexpr auto SaveDelay = std::chrono::seconds(10);
+
+	std::shared_mutex LibraryLock; // Exclusive while serializing
+	CComPtr<ID3D12PipelineLibrary1> Library;
+	std::vector<uint8_t> LibraryData; // Has to outlive the library
+	FileHeader CurrentHeader;
+	std::atomic_size_t LibraryPipelineCount = 0;
+
+	// Pipelines loaded from or stored in the library until the first save
+	std::mutex SessionLock;
+	std::unordered_map<std::wstring, CComPtr<ID3D12PipelineState>> SessionPipelines;
+	bool SessionSettled = false;
+
+	std::mutex SaveLock;
+	std::condition_variable SaveRequested;
+	size_t PendingStores = 0;
+	size_t PendingLoads = 0; // Only counted until the first save
+
+	std::filesystem::path GetLibraryPath()
+	{
+		return Plugin::GetThisModulePath().parent_path() / BUILD_PROJECT_NAME ".pipelines";
+	}
+
+	bool QueryAdapter(ID3D12Device2 *Device, FileHeader& Header)
+	{
+		CComPtr<IDXGIFactory4> factory;
+		CComPtr<IDXGIAdapter1> adapter;
+
+		if (FAILED(CreateDXGIFactory1(IID_PPV_ARGS(&factory))) ||
+			FAILED(factory->EnumAdapterByLuid(Device->GetAdapterLuid(), IID_PPV_ARGS(&adapter))))
+			return false;
+
+		DXGI_ADAPTER_DESC1 desc = {};
+		LARGE_INTEGER driverVersion = {};
+
+		if (FAILED(adapter->GetDesc1(&desc)) || FAILED(adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &driverVersion)))
+			return false;
+
+		Header.VendorId = desc.VendorId;
+		Header.DeviceId = desc.DeviceId;
+		Header.SubSysId = desc.SubSysId;
+		Header.Revision = desc.Revision;
+		Header.DriverVersion = static_cast<uint64_t>(driverVersion.QuadPart);
+
+		return true;
+	}
+
+	bool ReadLibraryFile(const std::filesystem::path& Path)
+	{
+		std::ifstream f(Path, std::ios::binary | std::ios::ate);
+
+		if (!f.good())
+			return false;
+
+		const auto fileSize = static_cast<size_t>(f.tellg());
+		FileHeader header;
+
+		if (fileSize <= sizeof(header) || !f.seekg(0).read(reinterpret_cast<char *>(&header), sizeof(header)))
+			return false;
+
+		if (!header.IsSameAdapter(CurrentHeader))
+		{
+			spdlog::info("Discarding patched pipeline library. The graphics card or driver changed.");
+			return false;
+		}
+
+		LibraryPipelineCount = header.PipelineCount;
+		LibraryData.resize(fileSize - sizeof(header));
+		return static_cast<bool>(f.read(reinterpret_cast<char *>(LibraryData.data()), LibraryData.size()));
+	}
+
+	void RecordSessionPipeline(const wchar_t *Name, IUnknown *PipelineState)
+	{
+		std::scoped_lock lock(SessionLock);
+
+		if (SessionSettled)
+			return;
+
+		CComPtr<ID3D12PipelineState> pipelineState;
+
+		if (SUCCEEDED(PipelineState->QueryInterface(IID_PPV_ARGS(&pipelineState))))
+			SessionPipelines.try_emplace(Name, std::move(pipelineState));
+	}
+
+	void NotifyLoad()
+	{
+		{
+			std::scoped_lock lock(SessionLock, SaveLock);
+
+			if (SessionSettled)
+				return;
+
+			PendingLoads++;
+		}
+
+		SaveRequested.notify_one();
+	}
+
+	bool CompactLibrary()
+	{
+		std::unique_lock lock(LibraryLock);
+		std::unordered_map<std::wstring, CComPtr<ID3D12PipelineState>> sessionPipelines;
+
+		{
+			std::scoped_lock sessionLock(SessionLock);
+
+			sessionPipelines = std::move(SessionPipelines);
+			SessionPipelines.clear();
+			SessionSettled = true;
+		}
+
+		const size_t libraryCount = LibraryPipelineCount;
+		const auto staleCount = libraryCount - std::min(libraryCount, sessionPipelines.size());
+
+		if (staleCount == 0 || staleCount <= libraryCount / StalePipelineDivisor)
+			return false;
+
+		CComPtr<ID3D12Device2> device;
+		CComPtr<ID3D12PipelineLibrary1> newLibrary;
+
+		if (FAILED(Library->GetDevice(IID_PPV_ARGS(&device))) ||
+			FAILED(device->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&newLibrary))))
+		{
+			spdlog::error("Failed to create a pipeline library. Stale patched pipelines are kept.");
+			return false;
+		}
+
+		size_t storedCount = 0;
+
+		for (const auto& [name, pipelineState] : sessionPipelines)
+		{
+			if (SUCCEEDED(newLibrary->StorePipeline(name.c_str(), pipelineState.Get())))
+				storedCount++;
+		}
+
+		// LibraryData stays around. It's only a copy of the file and pipelines loaded from it might still be alive.
+		Library = std::move(newLibrary);
+		LibraryPipelineCount = storedCount;
+
+		spdlog::info("Rebuilt patched pipeline library. Dropped {} pipeline(s) that weren't used this session.", staleCount);
+		return true;
+	}
+
+	void SaveLibrary()
+	{
+		std::vector<uint8_t> data;
+		FileHeader header = CurrentHeader;
+
+		{
+			std::unique_lock lock(LibraryLock);
+
+			data.resize(Library->GetSerializedSize());
+			header.PipelineCount = static_cast<uint32_t>(LibraryPipelineCount);
+
+			if (FAILED(Library->Serialize(data.data(), data.size())))
+			{
+				spdlog::error("Failed to serialize the patched pipeline library.");
+				return;
+			}
+		}
+
+		const auto path = GetLibraryPath();
+		auto tempPath = path;
+		tempPath += ".tmp";
+
+		// A full disk leaves a truncated file behind. It must not replace the previous library.
+		bool written = false;
+
+		if (std::ofstream f(tempPath, std::ios::binary | std::ios::trunc); f.good())
+		{
+			f.write(reinterpret_cast<const char *>(&header), sizeof(header));
+			f.write(reinterpret_cast<const char *>(data.data()), data.size());
+			f.flush();
+
+			written = f.good();
+		}
+
+		std::error_code ec;
+
+		if (!written)
+		{
+			std::filesystem::remove(tempPath, ec);
+			spdlog::error("Failed to write patched pipeline library: {}", tempPath.string());
+
+			return;
+		}
+
+		std::filesystem::rename(tempPath, path, ec);
+
+		if (ec)
+			spdlog::error("Failed to write patched pipeline library: {}", ec.message());
+		else
+			spdlog::info("Saved patched pipeline library ({:.1f} MB).", data.size() / (1024.0 * 1024.0));
+	}
+
+	void SaveThread()
+	{
+		bool settled = false;
+
+		while (true)
+		{
+			std::unique_lock lock(SaveLock);
+
+			SaveRequested.wait(
+				lock,
+				[]
+				{
+					return PendingStores > 0 || PendingLoads > 0;
+				});
+
+			// Keep waiting while pipelines are still coming in
+			while (true)
+			{
+				const auto countBefore = PendingStores + PendingLoads;
+				SaveRequested.wait_for(lock, SaveDelay);
+
+				if (PendingStores + PendingLoads == countBefore)
+					break;
+			}
+
+			const bool stored = PendingStores > 0;
+			PendingStores = 0;
+			PendingLoads = 0;
+			lock.unlock();
+
+			// Sessions that only loaded pipelines still get rid of stale ones
+			const bool rebuilt = !settled && CompactLibrary();
+			settled = true;
+
+			if (stored || rebuilt)
+				SaveLibrary();
+		}
+	}
+
+	bool Initialize(ID3D12Device2 *Device)
+	{
+		if (!QueryAdapter(Device, CurrentHeader))
+		{
+			spdlog::error("Failed to query the graphics adapter. Patched pipelines won't be cached.");
+			return false;
+		}
+
+		const auto path = GetLibraryPath();
+
+		if (ReadLibraryFile(path))
+		{
+			const auto hr = Device->CreatePipelineLibrary(LibraryData.data(), LibraryData.size(), IID_PPV_ARGS(&Library));
+
+			if (SUCCEEDED(hr))
+				spdlog::info("Loaded patched pipeline library: {}", path.string());
+			else
+				spdlog::info("Discarding patched pipeline library: {:X}.", static_cast<uint32_t>(hr));
+		}
+
+		if (!Library)
+		{
+			LibraryData.clear();
+			LibraryPipelineCount = 0;
+
+			if (FAILED(Device->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&Library))))
+			{
+				spdlog::error("Failed to create a pipeline library. Patched pipelines won't be cached.");
+				return false;
+			}
+		}
+
+		std::thread(SaveThread).detach();
+		return true;
+	}
+
+	bool IsEnabled()
+	{
+		return Plugin::CachePatchedPipelines;
+	}
+
+	void GetPipelineName(uint64_t TechniqueId, const ShaderDigest::Hash& Fingerprint, wchar_t (&Output)[64])
+	{
+		swprintf_s(
+			Output,
+			L"%llX-%016llX%016llX",
+			TechniqueId,
+			static_cast<unsigned long long>(Fingerprint.High),
+			static_cast<unsigned long long>(Fingerprint.Low));
+	}
+
+	bool LoadPipeline(
+		ID3D12Device2 *Device,
+		const wchar_t *Name,
+		const D3D12_PIPELINE_STATE_STREAM_DESC *Desc,
+		REFIID Riid,
+		void **PipelineState)
+	{
+		static bool initialized = Initialize(Device);
+
+		if (!initialized)
+			return false;
+
+		std::shared_lock lock(LibraryLock);
+
+		if (FAILED(Library->LoadPipeline(Name, Desc, Riid, PipelineState)))
+			return false;
+
+		RecordSessionPipeline(Name, static_cast<IUnknown *>(*PipelineState));
+		NotifyLoad();
+
+		return true;
+	}
+
+	void StorePipeline(const wchar_t *Name, ID3D12PipelineState *PipelineState)
+	{
+		if (!Library)
+			return;
+
+		{
+			// E_INVALIDARG means that the name is already taken, e.g. when the same technique is created twice
+			std::shared_lock lock(LibraryLock);
+
+			if (FAILED(Library->StorePipeline(Name, PipelineState)))
+				return;
+
+			LibraryPipelineCount++;
+			RecordSessionPipeline(Name, PipelineState);
+		}
+
+		{
+			std::scoped_lock lock(SaveLock);
+			PendingStores++;
+		}
+
+		SaveRequested.notify_one();
+	}
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "ShaderDigest.h"
+
+namespace PatchedPipelineLibrary
+{
+	bool IsEnabled();
+	void GetPipelineName(uint64_t TechniqueId, const ShaderDigest::Hash& Fingerprint, wchar_t (&Output)[64]);
+
+	bool LoadPipeline(
+		ID3D12Device2 *Device,
+		const wchar_t *Name,
+		const D3D12_PIPELINE_STATE_STREAM_DESC *Desc,
+		REFIID Riid,
+		void **PipelineState);
+	void StorePipeline(const wchar_t *Name, ID3D12PipelineState *PipelineState);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include "DXContainer.h"
+#include "ShaderDigest.h"
+
+//
+// Hashing rules behind D3DPipelineStateStream::Fingerprint(). Subobjects are added in stream order and each one
+// starts with its type, so reordering them or moving a shader to another stage changes the result. Pointer values
+// never enter the hash unless nothing else identifies the object. This header has no platform dependencies and is
+// shared with the tests.
+//
+namespace PipelineFingerprint
+{
+	class Builder
+	{
+	private:
+		ShaderDigest::Builder m_Builder;
+
+	public:
+		void BeginSubobject(uint32_t Type)
+		{
+			m_Builder.AddValue(Type);
+		}
+
+		void AddShader(const void *Bytecode, size_t Length)
+		{
+			// Signed containers already carry a digest of their contents. Hashing them again is a waste of time.
+			if (auto digest = DXContainer::GetDigest(Bytecode, Length))
+				m_Builder.AddValue(*digest);
+			else if (Bytecode)
+				m_Builder.AddValue(ShaderDigest::Compute(Bytecode, Length));
+
+			m_Builder.AddValue(Length);
+		}
+
+		// Tagged custom signatures use the tag, all others use Data if given and fall back to the object address
+		void AddRootSignature(const void *Object, const std::optional<ShaderDigest::Hash>& Tag, const std::span<const uint8_t> *Data)
+		{
+			if (!Object)
+				return;
+
+			if (Tag)
+				m_Builder.AddValue(*Tag);
+			else if (Data)
+				m_Builder.AddValue(ShaderDigest::Compute(Data->data(), Data->size()));
+			else
+				m_Builder.AddValue(Object);
+		}
+
+		// Includes the terminator so that adjacent strings can't run into each other
+		void AddString(const char *String)
+		{
+			if (String)
+				m_Builder.Add(String, strlen(String) + 1);
+		}
+
+		void Add(const void *Data, size_t Size)
+		{
+			m_Builder.Add(Data, Size);
+		}
+
+		template<typename T>
+		void AddValue(const T& Value)
+		{
+			m_Builder.AddValue(Value);
+		}
+
+		ShaderDigest::Hash Finish() const
+		{
+			return m_Builder.Finish();
+		}
+	};
+}
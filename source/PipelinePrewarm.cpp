@@ -0,0 +1,652 @@
+#include <condition_variable>
+#include <execution>
+#include <future>
+#include "D3DPipelineStateStream.h"
+#include "D3DShaderReplacement.h"
+#include "DebuggingUtil.h"
+#include "PatchedPipelineLibrary.h"
+#include "PipelinePrewarm.h"
+#include "PipelinePrewarmFormat.h"
+#include "Plugin.h"
+
+namespace PipelinePrewarm
+{
+	//
+	// Pipelines with custom shaders are recorded while the game creates them. The next session compiles them on a
+	// background thread pool before the game gets around to asking for them.
+	//
+	// Entries hold the game's original stream rather than the patched one. Custom shaders are applied again while
+	// prewarming, so edited or removed files never produce stale pipelines. The patched stream's fingerprint is
+	// recorded as well and is used to match prewarmed pipelines to the game's requests.
+	//
+	using BlobMap = std::unordered_map<ShaderDigest::Hash, std::vector<uint8_t>, ShaderDigest::Hasher>;
+
+	struct RecordedPipeline
+	{
+		PipelinePrewarmFormat::EntryHeader Header;
+		std::string Name;
+		std::vector<uint8_t> Stream;
+	};
+
+	struct PendingPipeline
+	{
+		enum class Status
+		{
+			Queued,
+			Compiling,
+			Finished,
+			Skipped,
+		};
+
+		std::atomic<Status> State = Status::Queued;
+		std::promise<CComPtr<ID3D12PipelineState>> Promise;
+		std::shared_future<CComPtr<ID3D12PipelineState>> Result = Promise.get_future().share();
+	};
+
+	// The manifest is only written after this long without new pipelines, i.e. once loading has finished
+	constexpr auto SaveDelay = std::chrono::seconds(10);
+
+	std::mutex RecordLock;
+	std::condition_variable RecordAdded;
+	std::unordered_map<ShaderDigest::Hash, RecordedPipeline, ShaderDigest::Hasher> RecordedPipelines; // Keyed by fingerprint
+	BlobMap RecordedBlobs;
+	size_t PendingRecords = 0;
+
+	std::mutex PendingLock;
+	std::unordered_map<ShaderDigest::Hash, std::shared_ptr<PendingPipeline>, ShaderDigest::Hasher> PendingPipelines;
+
+	std::filesystem::path GetManifestPath()
+	{
+		return Plugin::GetThisModulePath().parent_path() / BUILD_PROJECT_NAME ".prewarm";
+	}
+
+	ShaderDigest::Hash AddBlob(BlobMap& Blobs, const void *Data, size_t Size)
+	{
+		if (!Data || Size == 0)
+			return {};
+
+		const auto digest = ShaderDigest::Compute(Data, Size);
+
+		if (!Blobs.contains(digest))
+			Blobs.emplace(digest, std::vector<uint8_t>(static_cast<const uint8_t *>(Data), static_cast<const uint8_t *>(Data) + Size));
+
+		return digest;
+	}
+
+	std::vector<uint8_t> FlattenStream(const D3D12_PIPELINE_STATE_STREAM_DESC *Desc, BlobMap& Blobs)
+	{
+		// Subobjects are written as their type followed by the payload. Pointers are replaced by what they point to.
+		std::vector<uint8_t> output;
+
+		auto write = [&](const void *Data, size_t Size)
+		{
+			output.insert(output.end(), static_cast<const uint8_t *>(Data), static_cast<const uint8_t *>(Data) + Size);
+		};
+
+		auto writeString = [&](const char *String)
+		{
+			const auto length = static_cast<uint32_t>(String ? strlen(String) : 0);
+
+			write(&length, sizeof(length));
+			write(String, length);
+			output.emplace_back('\0');
+		};
+
+		for (D3DPipelineStateStream::Iterator iter(Desc); !iter.AtEnd(); iter.Advance())
+		{
+			const auto obj = iter.GetObj();
+			write(&obj->Type, sizeof(obj->Type));
+
+			switch (obj->Type)
+			{
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_HS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_GS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_AS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_MS:
+			{
+				const auto digest = AddBlob(Blobs, obj->Shader.pShaderBytecode, obj->Shader.BytecodeLength);
+				write(&digest, sizeof(digest));
+			}
+			break;
+
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CACHED_PSO:
+				// Root signatures are created from the entry's blob. Cached blobs belong to the game's library.
+				break;
+
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_STREAM_OUTPUT:
+				write(&obj->StreamOutput.NumEntries, sizeof(UINT));
+
+				for (UINT i = 0; i < obj->StreamOutput.NumEntries; i++)
+				{
+					auto entry = obj->StreamOutput.pSODeclaration[i];
+					writeString(entry.SemanticName);
+
+					entry.SemanticName = nullptr;
+					write(&entry, sizeof(entry));
+				}
+
+				write(&obj->StreamOutput.NumStrides, sizeof(UINT));
+				write(obj->StreamOutput.pBufferStrides, obj->StreamOutput.NumStrides * sizeof(UINT));
+				write(&obj->StreamOutput.RasterizedStream, sizeof(UINT));
+				break;
+
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT:
+				write(&obj->InputLayout.NumElements, sizeof(UINT));
+
+				for (UINT i = 0; i < obj->InputLayout.NumElements; i++)
+				{
+					auto element = obj->InputLayout.pInputElementDescs[i];
+					writeString(element.SemanticName);
+
+					element.SemanticName = nullptr;
+					write(&element, sizeof(element));
+				}
+				break;
+
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VIEW_INSTANCING:
+				write(&obj->ViewInstancing.ViewInstanceCount, sizeof(UINT));
+				write(obj->ViewInstancing.pViewInstanceLocations, obj->ViewInstancing.ViewInstanceCount * sizeof(D3D12_VIEW_INSTANCE_LOCATION));
+				write(&obj->ViewInstancing.Flags, sizeof(obj->ViewInstancing.Flags));
+				break;
+
+			default:
+			{
+				const auto alignment = D3DPipelineStateStream::Iterator::GetAlignmentForType(obj->Type);
+				const auto payloadOffset = (sizeof(obj->Type) + alignment - 1) & ~(alignment - 1);
+
+				write(reinterpret_cast<const uint8_t *>(obj) + payloadOffset, D3DPipelineStateStream::Iterator::GetSizeForType(obj->Type));
+			}
+			break;
+			}
+		}
+
+		return output;
+	}
+
+	bool RebuildStream(
+		std::span<const uint8_t> Flattened,
+		const PipelinePrewarmFormat::BlobViewMap& Blobs,
+		ID3D12RootSignature *RootSignature,
+		std::vector<uint8_t>& Stream,
+		std::vector<std::vector<uint8_t>>& Storage)
+	{
+		// Inverse of FlattenStream(). Pointers refer to Flattened, Blobs, and Storage so they all have to outlive the
+		// stream.
+		PipelinePrewarmFormat::Reader reader(Flattened);
+
+		auto append = [&](D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type, const void *Payload)
+		{
+			const auto alignment = D3DPipelineStateStream::Iterator::GetAlignmentForType(Type);
+			const auto size = D3DPipelineStateStream::Iterator::GetSizeForType(Type);
+
+			Stream.resize((Stream.size() + alignof(void *) - 1) & ~(alignof(void *) - 1));
+			Stream.insert(Stream.end(), reinterpret_cast<const uint8_t *>(&Type), reinterpret_cast<const uint8_t *>(&Type) + sizeof(Type));
+			Stream.resize((Stream.size() + alignment - 1) & ~(alignment - 1));
+			Stream.insert(Stream.end(), static_cast<const uint8_t *>(Payload), static_cast<const uint8_t *>(Payload) + size);
+		};
+
+		auto store = [&](size_t Size)
+		{
+			return Storage.emplace_back(Size).data();
+		};
+
+		while (!reader.AtEnd())
+		{
+			D3D12_PIPELINE_STATE_SUBOBJECT_TYPE type;
+
+			if (!reader.Read(type))
+				return false;
+
+			switch (type)
+			{
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_HS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_GS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_AS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_MS:
+			{
+				ShaderDigest::Hash digest;
+				D3D12_SHADER_BYTECODE bytecode = {};
+
+				if (!reader.Read(digest))
+					return false;
+
+				if (!digest.IsZero())
+				{
+					const auto itr = Blobs.find(digest);
+
+					if (itr == Blobs.end())
+						return false;
+
+					bytecode.pShaderBytecode = itr->second.data();
+					bytecode.BytecodeLength = itr->second.size();
+				}
+
+				append(type, &bytecode);
+			}
+			break;
+
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE:
+				append(type, &RootSignature);
+				break;
+
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CACHED_PSO:
+			{
+				const D3D12_CACHED_PIPELINE_STATE cachedState = {};
+				append(type, &cachedState);
+			}
+			break;
+
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_STREAM_OUTPUT:
+			{
+				D3D12_STREAM_OUTPUT_DESC desc = {};
+
+				if (!reader.Read(desc.NumEntries))
+					return false;
+
+				auto entries = reinterpret_cast<D3D12_SO_DECLARATION_ENTRY *>(store(desc.NumEntries * sizeof(D3D12_SO_DECLARATION_ENTRY)));
+
+				for (UINT i = 0; i < desc.NumEntries; i++)
+				{
+					const auto name = reader.ReadString();
+
+					if (!name || !reader.Read(entries[i]))
+						return false;
+
+					entries[i].SemanticName = name;
+				}
+
+				if (!reader.Read(desc.NumStrides))
+					return false;
+
+				const auto strides = reader.ReadBytes(desc.NumStrides * sizeof(UINT));
+
+				if (!strides || !reader.Read(desc.RasterizedStream))
+					return false;
+
+				desc.pSODeclaration = entries;
+				desc.pBufferStrides = reinterpret_cast<const UINT *>(memcpy(store(desc.NumStrides * sizeof(UINT)), strides, desc.NumStrides * sizeof(UINT)));
+				append(type, &desc);
+			}
+			break;
+
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT:
+			{
+				D3D12_INPUT_LAYOUT_DESC desc = {};
+
+				if (!reader.Read(desc.NumElements))
+					return false;
+
+				auto elements = reinterpret_cast<D3D12_INPUT_ELEMENT_DESC *>(store(desc.NumElements * sizeof(D3D12_INPUT_ELEMENT_DESC)));
+
+				for (UINT i = 0; i < desc.NumElements; i++)
+				{
+					const auto name = reader.ReadString();
+
+					if (!name || !reader.Read(elements[i]))
+						return false;
+
+					elements[i].SemanticName = name;
+				}
+
+				desc.pInputElementDescs = elements;
+				append(type, &desc);
+			}
+			break;
+
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VIEW_INSTANCING:
+			{
+				D3D12_VIEW_INSTANCING_DESC desc = {};
+
+				if (!reader.Read(desc.ViewInstanceCount))
+					return false;
+
+				const auto size = desc.ViewInstanceCount * sizeof(D3D12_VIEW_INSTANCE_LOCATION);
+				const auto locations = reader.ReadBytes(size);
+
+				if (!locations || !reader.Read(desc.Flags))
+					return false;
+
+				desc.pViewInstanceLocations = reinterpret_cast<const D3D12_VIEW_INSTANCE_LOCATION *>(memcpy(store(size), locations, size));
+				append(type, &desc);
+			}
+			break;
+
+			default:
+			{
+				// Unknown types would throw off the payload sizes below
+				const auto size = D3DPipelineStateStream::Iterator::GetSizeForType(type);
+				const auto payload = reader.ReadBytes(size);
+
+				if (!payload)
+					return false;
+
+				append(type, payload);
+			}
+			break;
+			}
+		}
+
+		Stream.resize((Stream.size() + alignof(void *) - 1) & ~(alignof(void *) - 1));
+		return true;
+	}
+
+	void SaveManifest()
+	{
+		std::vector<uint8_t> data;
+
+		{
+			std::scoped_lock lock(RecordLock);
+			std::vector<PipelinePrewarmFormat::BlobView> blobs;
+			std::vector<PipelinePrewarmFormat::EntryView> entries;
+
+			blobs.reserve(RecordedBlobs.size());
+			entries.reserve(RecordedPipelines.size());
+
+			for (const auto& [digest, blob] : RecordedBlobs)
+				blobs.emplace_back(PipelinePrewarmFormat::BlobView { .Digest = digest, .Data = blob });
+
+			for (const auto& [fingerprint, pipeline] : RecordedPipelines)
+			{
+				entries.emplace_back(PipelinePrewarmFormat::EntryView {
+					.Header = pipeline.Header,
+					.Name = pipeline.Name,
+					.Stream = pipeline.Stream,
+				});
+			}
+
+			data = PipelinePrewarmFormat::Write(blobs, entries);
+		}
+
+		const auto path = GetManifestPath();
+		auto tempPath = path;
+		tempPath += ".tmp";
+
+		if (std::ofstream f(tempPath, std::ios::binary | std::ios::trunc); f.good())
+			f.write(reinterpret_cast<const char *>(data.data()), data.size());
+
+		std::error_code ec;
+		std::filesystem::rename(tempPath, path, ec);
+
+		if (ec)
+			spdlog::error("Failed to write pipeline prewarm list: {}", ec.message());
+	}
+
+	void SaveThread()
+	{
+		while (true)
+		{
+			std::unique_lock lock(RecordLock);
+
+			RecordAdded.wait(
+				lock,
+				[]
+				{
+					return PendingRecords > 0;
+				});
+
+			// Keep waiting while pipelines are still coming in
+			while (true)
+			{
+				const auto recordedBefore = PendingRecords;
+				RecordAdded.wait_for(lock, SaveDelay);
+
+				if (PendingRecords == recordedBefore)
+					break;
+			}
+
+			PendingRecords = 0;
+			lock.unlock();
+
+			SaveManifest();
+		}
+	}
+
+	struct LoadedManifest
+	{
+		std::vector<uint8_t> Data;
+		PipelinePrewarmFormat::BlobViewMap Blobs;
+		std::vector<PipelinePrewarmFormat::EntryView> Pipelines;
+	};
+
+	bool ReadManifest(const std::filesystem::path& Path, LoadedManifest& Manifest)
+	{
+		std::ifstream f(Path, std::ios::binary | std::ios::ate);
+
+		if (!f.good())
+			return false;
+
+		Manifest.Data.resize(static_cast<size_t>(f.tellg()));
+
+		if (!f.seekg(0).read(reinterpret_cast<char *>(Manifest.Data.data()), Manifest.Data.size()))
+			return false;
+
+		return PipelinePrewarmFormat::Parse(Manifest.Data, Manifest.Blobs, Manifest.Pipelines);
+	}
+
+	CComPtr<ID3D12PipelineState> Compile(
+		ID3D12Device2 *Device,
+		const LoadedManifest& Manifest,
+		const PipelinePrewarmFormat::EntryView& Pipeline)
+	{
+		const auto rootSignatureBlob = Manifest.Blobs.find(Pipeline.Header.RootSignatureDigest);
+
+		if (rootSignatureBlob == Manifest.Blobs.end())
+			return nullptr;
+
+		// The runtime hands out the same object for identical root signature blobs, so this is the game's signature
+		const auto& rootSignatureData = rootSignatureBlob->second;
+		CComPtr<ID3D12RootSignature> rootSignature;
+
+		if (FAILED(Device->CreateRootSignature(0, rootSignatureData.data(), rootSignatureData.size(), IID_PPV_ARGS(&rootSignature))))
+			return nullptr;
+
+		std::vector<uint8_t> stream;
+		std::vector<std::vector<uint8_t>> storage;
+
+		if (!RebuildStream(Pipeline.Stream, Manifest.Blobs, rootSignature.Get(), stream, storage))
+			return nullptr;
+
+		const D3D12_PIPELINE_STATE_STREAM_DESC desc {
+			.SizeInBytes = stream.size(),
+			.pPipelineStateSubobjectStream = stream.data(),
+		};
+
+		// Skip pipelines whose custom shaders were removed or changed since they were recorded. The game won't ask
+		// for them.
+		D3DPipelineStateStream::Copy streamCopy(&desc);
+
+		if (!D3DShaderReplacement::PatchPipelineStateStream(
+				streamCopy,
+				Device,
+				&rootSignatureData,
+				Pipeline.Name.data(),
+				Pipeline.Header.TechniqueId,
+				{}))
+			return nullptr;
+
+		const auto fingerprint = D3DPipelineStateStream::Fingerprint(streamCopy.GetDesc(), &rootSignatureData);
+
+		if (fingerprint != Pipeline.Header.PatchedFingerprint)
+			return nullptr;
+
+		CComPtr<ID3D12PipelineState> pipelineState;
+		wchar_t pipelineName[64] = {};
+
+		if (PatchedPipelineLibrary::IsEnabled())
+		{
+			PatchedPipelineLibrary::GetPipelineName(Pipeline.Header.TechniqueId, fingerprint, pipelineName);
+
+			if (PatchedPipelineLibrary::LoadPipeline(Device, pipelineName, streamCopy.GetDesc(), IID_PPV_ARGS(&pipelineState)))
+				return pipelineState;
+		}
+
+		if (FAILED(Device->CreatePipelineState(streamCopy.GetDesc(), IID_PPV_ARGS(&pipelineState))))
+			return nullptr;
+
+		if (pipelineName[0] != L'\0')
+			PatchedPipelineLibrary::StorePipeline(pipelineName, pipelineState.Get());
+
+		DebuggingUtil::SetObjectDebugName(pipelineState.Get(), Pipeline.Name.data());
+		return pipelineState;
+	}
+
+	void PrewarmThread(CComPtr<ID3D12Device2> Device, std::shared_ptr<LoadedManifest> Manifest)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		std::atomic_size_t compiledCount = 0;
+
+		std::for_each(
+			std::execution::par,
+			Manifest->Pipelines.begin(),
+			Manifest->Pipelines.end(),
+			[&](const PipelinePrewarmFormat::EntryView& Pipeline)
+			{
+				std::shared_ptr<PendingPipeline> pending;
+
+				{
+					std::scoped_lock lock(PendingLock);
+
+					if (auto itr = PendingPipelines.find(Pipeline.Header.PatchedFingerprint); itr != PendingPipelines.end())
+						pending = itr->second;
+				}
+
+				// The game might've asked for it first
+				if (!pending)
+					return;
+
+				auto expected = PendingPipeline::Status::Queued;
+
+				if (!pending->State.compare_exchange_strong(expected, PendingPipeline::Status::Compiling))
+					return;
+
+				auto pipelineState = Compile(Device.Get(), *Manifest, Pipeline);
+
+				if (pipelineState)
+					compiledCount++;
+
+				pending->Promise.set_value(std::move(pipelineState));
+				pending->State = PendingPipeline::Status::Finished;
+			});
+
+		const auto end = std::chrono::steady_clock::now();
+
+		// Results the game hasn't asked for by now are released. Pipelines requested later still come from the patched
+		// pipeline library instead of being compiled again.
+		size_t unclaimedCount = 0;
+
+		{
+			std::scoped_lock lock(PendingLock);
+
+			unclaimedCount = PendingPipelines.size();
+			PendingPipelines.clear();
+		}
+
+		spdlog::info(
+			"Prewarmed {} of {} pipeline(s) with custom shaders in {} ms. {} weren't requested by the game.",
+			compiledCount.load(),
+			Manifest->Pipelines.size(),
+			std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count(),
+			unclaimedCount);
+	}
+
+	bool IsEnabled()
+	{
+		return Plugin::PrewarmPatchedPipelines && Plugin::ShaderDumpBinPath.empty();
+	}
+
+	void Start(CComPtr<ID3D12Device2> Device)
+	{
+		if (!IsEnabled())
+			return;
+
+		std::thread(SaveThread).detach();
+
+		// Read before anything is recorded. Pipelines have to be registered before the game's first request.
+		auto manifest = std::make_shared<LoadedManifest>();
+
+		if (!ReadManifest(GetManifestPath(), *manifest) || manifest->Pipelines.empty())
+			return;
+
+		{
+			// Duplicate fingerprints share one pending entry and are only compiled once
+			std::scoped_lock lock(PendingLock);
+
+			std::erase_if(
+				manifest->Pipelines,
+				[](const PipelinePrewarmFormat::EntryView& Pipeline)
+				{
+					return !PendingPipelines.try_emplace(Pipeline.Header.PatchedFingerprint, std::make_shared<PendingPipeline>()).second;
+				});
+		}
+
+		std::thread(PrewarmThread, std::move(Device), std::move(manifest)).detach();
+	}
+
+	void Record(
+		const D3D12_PIPELINE_STATE_STREAM_DESC *Desc,
+		std::span<const uint8_t> RootSignatureData,
+		const char *TechniqueName,
+		uint64_t TechniqueId,
+		const ShaderDigest::Hash& PatchedFingerprint)
+	{
+		{
+			std::scoped_lock lock(RecordLock);
+
+			if (RecordedPipelines.contains(PatchedFingerprint))
+				return;
+
+			RecordedPipeline pipeline {
+				.Header = {
+					.TechniqueId = TechniqueId,
+					.PatchedFingerprint = PatchedFingerprint,
+					.RootSignatureDigest = AddBlob(RecordedBlobs, RootSignatureData.data(), RootSignatureData.size()),
+				},
+				.Name = TechniqueName,
+				.Stream = FlattenStream(Desc, RecordedBlobs),
+			};
+
+			RecordedPipelines.emplace(PatchedFingerprint, std::move(pipeline));
+			PendingRecords++;
+		}
+
+		RecordAdded.notify_one();
+	}
+
+	CComPtr<ID3D12PipelineState> Take(const ShaderDigest::Hash& PatchedFingerprint)
+	{
+		std::shared_ptr<PendingPipeline> pending;
+
+		{
+			// Handed out once. Later requests for the same fingerprint are served by pipeline sharing or the library.
+			std::scoped_lock lock(PendingLock);
+
+			if (auto itr = PendingPipelines.find(PatchedFingerprint); itr != PendingPipelines.end())
+			{
+				pending = std::move(itr->second);
+				PendingPipelines.erase(itr);
+			}
+		}
+
+		if (!pending)
+			return nullptr;
+
+		// Not started yet. Compiling it right away is faster than waiting for the rest of the queue.
+		auto expected = PendingPipeline::Status::Queued;
+
+		if (pending->State.compare_exchange_strong(expected, PendingPipeline::Status::Skipped) ||
+			expected == PendingPipeline::Status::Skipped)
+			return nullptr;
+
+		// Either finished or being compiled right now. Waiting is never slower than compiling it again.
+		return pending->Result.get();
+	}
+}
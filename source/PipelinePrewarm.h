@@ -0,0 +1,18 @@
+#pragma once
+
+#include "CComPtr.h"
+#include "ShaderDigest.h"
+
+namespace PipelinePrewarm
+{
+	bool IsEnabled();
+	void Start(CComPtr<ID3D12Device2> Device);
+
+	void Record(
+		const D3D12_PIPELINE_STATE_STREAM_DESC *Desc,
+		std::span<const uint8_t> RootSignatureData,
+		const char *TechniqueName,
+		uint64_t TechniqueId,
+		const ShaderDigest::Hash& PatchedFingerprint);
+	CComPtr<ID3D12PipelineState> Take(const ShaderDigest::Hash& PatchedFingerprint);
+}
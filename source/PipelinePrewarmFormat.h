@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "ShaderDigest.h"
+
+//
+// Prewarm manifests list pipelines with custom shaders recorded in a previous session:
+//
+// [FileHeader]
+// [Blobs]               BlobHeader followed by the data. Shaders and root signatures are stored once.
+// [Entries]             EntryHeader, null terminated technique name, flattened stream
+//
+// Flattened streams are opaque at this level. This header has no platform dependencies and is shared with the tests.
+//
+namespace PipelinePrewarmFormat
+{
+	struct FileHeader
+	{
+		constexpr static uint32_t ExpectedMagic = 0x4D575053; // "SPWM"
+		constexpr static uint32_t ExpectedVersion = 1;
+
+		uint32_t Magic = ExpectedMagic;
+		uint32_t Version = ExpectedVersion;
+		uint32_t BlobCount = 0;
+		uint32_t EntryCount = 0;
+	};
+	static_assert(sizeof(FileHeader) == 16);
+
+	struct BlobHeader
+	{
+		ShaderDigest::Hash Digest;
+		uint64_t Size = 0;
+	};
+	static_assert(sizeof(BlobHeader) == 24);
+
+	struct EntryHeader
+	{
+		uint64_t TechniqueId = 0;
+		ShaderDigest::Hash PatchedFingerprint;
+		ShaderDigest::Hash RootSignatureDigest;
+		uint32_t NameLength = 0;
+		uint32_t StreamSize = 0;
+	};
+	static_assert(sizeof(EntryHeader) == 48);
+
+	using BlobViewMap = std::unordered_map<ShaderDigest::Hash, std::span<const uint8_t>, ShaderDigest::Hasher>;
+
+	struct BlobView
+	{
+		ShaderDigest::Hash Digest;
+		std::span<const uint8_t> Data;
+	};
+
+	struct EntryView
+	{
+		EntryHeader Header; // NameLength and StreamSize are filled in by Write()
+		std::string_view Name; // Null terminated when returned by Parse()
+		std::span<const uint8_t> Stream;
+	};
+
+	class Reader
+	{
+	private:
+		std::span<const uint8_t> m_Data;
+		size_t m_Offset = 0;
+
+	public:
+		Reader(std::span<const uint8_t> Data) : m_Data(Data)
+		{
+		}
+
+		bool AtEnd() const
+		{
+			return m_Offset >= m_Data.size();
+		}
+
+		const uint8_t *ReadBytes(size_t Size)
+		{
+			if (Size > m_Data.size() - m_Offset)
+				return nullptr;
+
+			const auto data = m_Data.data() + m_Offset;
+			m_Offset += Size;
+
+			return data;
+		}
+
+		template<typename T>
+		bool Read(T& Output)
+		{
+			const auto data = ReadBytes(sizeof(T));
+
+			if (data)
+				memcpy(&Output, data, sizeof(T));
+
+			return data != nullptr;
+		}
+
+		const char *ReadString()
+		{
+			// Points into the underlying data, which includes the terminator
+			uint32_t length = 0;
+			const auto data = Read(length) ? ReadBytes(length + 1ull) : nullptr;
+
+			return (data && data[length] == '\0') ? reinterpret_cast<const char *>(data) : nullptr;
+		}
+	};
+
+	inline std::vector<uint8_t> Write(std::span<const BlobView> Blobs, std::span<const EntryView> Entries)
+	{
+		std::vector<uint8_t> output;
+
+		auto write = [&](const void *Data, size_t Size)
+		{
+			output.insert(output.end(), static_cast<const uint8_t *>(Data), static_cast<const uint8_t *>(Data) + Size);
+		};
+
+		const FileHeader header {
+			.BlobCount = static_cast<uint32_t>(Blobs.size()),
+			.EntryCount = static_cast<uint32_t>(Entries.size()),
+		};
+
+		write(&header, sizeof(header));
+
+		for (const auto& blob : Blobs)
+		{
+			const BlobHeader blobHeader {
+				.Digest = blob.Digest,
+				.Size = blob.Data.size(),
+			};
+
+			write(&blobHeader, sizeof(blobHeader));
+			write(blob.Data.data(), blob.Data.size());
+		}
+
+		for (const auto& entry : Entries)
+		{
+			auto entryHeader = entry.Header;
+			entryHeader.NameLength = static_cast<uint32_t>(entry.Name.size());
+			entryHeader.StreamSize = static_cast<uint32_t>(entry.Stream.size());
+
+			write(&entryHeader, sizeof(entryHeader));
+			write(entry.Name.data(), entry.Name.size());
+			output.emplace_back('\0');
+			write(entry.Stream.data(), entry.Stream.size());
+		}
+
+		return output;
+	}
+
+	// Returned views point into Data. Fails on anything that doesn't exactly match what Write() produces, including
+	// blobs whose contents don't match their digest.
+	inline bool Parse(std::span<const uint8_t> Data, BlobViewMap& Blobs, std::vector<EntryView>& Entries)
+	{
+		Reader reader(Data);
+		FileHeader header;
+
+		Blobs.clear();
+		Entries.clear();
+
+		if (!reader.Read(header) || header.Magic != FileHeader::ExpectedMagic || header.Version != FileHeader::ExpectedVersion)
+			return false;
+
+		for (uint32_t i = 0; i < header.BlobCount; i++)
+		{
+			BlobHeader blobHeader;
+			const uint8_t *data = nullptr;
+
+			if (!reader.Read(blobHeader) || !(data = reader.ReadBytes(blobHeader.Size)))
+				return false;
+
+			if (ShaderDigest::Compute(data, blobHeader.Size) != blobHeader.Digest)
+				return false;
+
+			Blobs.emplace(blobHeader.Digest, std::span(data, blobHeader.Size));
+		}
+
+		for (uint32_t i = 0; i < header.EntryCount; i++)
+		{
+			EntryView entry;
+			const uint8_t *name = nullptr;
+			const uint8_t *stream = nullptr;
+
+			if (!reader.Read(entry.Header) || !(name = reader.ReadBytes(entry.Header.NameLength + 1ull)) ||
+				name[entry.Header.NameLength] != '\0' || !(stream = reader.ReadBytes(entry.Header.StreamSize)))
+				return false;
+
+			entry.Name = std::string_view(reinterpret_cast<const char *>(name), entry.Header.NameLength);
+			entry.Stream = std::span(stream, entry.Header.StreamSize);
+			Entries.emplace_back(entry);
+		}
+
+		return reader.AtEnd();
+	}
+}
@@ -0,0 +1,326 @@
+#include "CComPtr.h"
+#include "D3DPipelineStateStream.h"
+#include "PipelineRetirement.h"
+
+namespace PipelineRetirement
+{
+	//
+	// Live updates swap pipelines out from under the game. The old pipeline may still be referenced by command lists
+	// that were recorded before the swap and haven't executed yet, so it can't be released right away.
+	//
+	// Every submission to a game queue is followed by a fence signal. Command lists recorded before a swap are
+	// submitted by the end of the following frame. Once that frame is presented, the last value signalled on each
+	// queue is remembered and the old pipeline is released after all of them complete.
+	//
+	// Queues are only referenced weakly. Signals are issued from the submission hook where the game guarantees the
+	// queue is alive, and a destroyed queue can't execute anything anymore so waits on it are considered complete.
+	//
+	struct QueueState
+	{
+		ID3D12CommandQueue *Queue = nullptr; // Identity only. Never dereferenced outside of the submission hook.
+		CComPtr<ID3D12Fence> Fence;
+		std::mutex SignalLock;
+		std::atomic_uint64_t LastSignalledValue;
+		std::atomic_bool Destroyed;
+	};
+
+	struct RetiredPipeline
+	{
+		CComPtr<ID3D12PipelineState> PipelineState;
+		uint64_t EstimatedSize = 0; // Bytes
+		uint64_t RetiredFrame = 0;
+		bool Armed = false;
+		std::vector<std::pair<std::shared_ptr<QueueState>, uint64_t>> FenceWaits;
+	};
+
+	// Frames that have to be presented after a swap before fence values are captured
+	constexpr uint64_t FramesBeforeArming = 2;
+
+	std::atomic_bool QueueHookInstalled;
+	std::atomic_bool QueueTrackingFailed;
+
+	std::mutex QueuesLock;
+	std::vector<std::shared_ptr<QueueState>> Queues;
+	std::atomic_uint64_t QueuesGeneration; // Bumped whenever a queue is destroyed
+
+	std::mutex RetiredPipelinesLock;
+	std::vector<RetiredPipeline> RetiredPipelines;
+	uint64_t FrameIndex = 0;
+	size_t TotalReleasedCount = 0;
+	uint64_t TotalReleasedSize = 0;
+
+	void(WINAPI *D3D12CommandQueueExecuteCommandLists)(ID3D12CommandQueue *, UINT, ID3D12CommandList *const *);
+
+	void WINAPI OnQueueDestroyed(void *Context)
+	{
+		std::scoped_lock lock(QueuesLock);
+
+		auto itr = std::find_if(
+			Queues.begin(),
+			Queues.end(),
+			[&](const std::shared_ptr<QueueState>& State)
+			{
+				return State.get() == Context;
+			});
+
+		if (itr == Queues.end())
+			return;
+
+		(*itr)->Destroyed = true;
+		(*itr)->Queue = nullptr;
+		Queues.erase(itr);
+
+		// A new queue may be created at the same address. Per-thread lookups have to be redone.
+		QueuesGeneration++;
+	}
+
+	std::shared_ptr<QueueState> TrackQueue(ID3D12CommandQueue *Queue)
+	{
+		// Submissions are frequent and the set of queues is tiny. Each thread remembers what it has already seen.
+		thread_local std::vector<std::pair<ID3D12CommandQueue *, std::shared_ptr<QueueState>>> seenQueues;
+		thread_local uint64_t seenGeneration = 0;
+
+		if (const uint64_t generation = QueuesGeneration; seenGeneration != generation)
+		{
+			seenQueues.clear();
+			seenGeneration = generation;
+		}
+
+		for (const auto& [queue, state] : seenQueues)
+		{
+			if (queue == Queue)
+				return state;
+		}
+
+		std::shared_ptr<QueueState> state;
+
+		{
+			std::scoped_lock lock(QueuesLock);
+
+			for (const auto& existing : Queues)
+			{
+				if (existing->Queue == Queue)
+				{
+					state = existing;
+					break;
+				}
+			}
+
+			if (!state)
+			{
+				CComPtr<ID3D12Device> device;
+				CComPtr<ID3D12Fence> fence;
+				CComPtr<ID3DDestructionNotifier> notifier;
+
+				if (FAILED(Queue->GetDevice(IID_PPV_ARGS(&device))) ||
+					FAILED(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence))) ||
+					FAILED(Queue->QueryInterface(IID_PPV_ARGS(&notifier))))
+				{
+					// Work on an untracked queue could still be using a retired pipeline
+					if (!QueueTrackingFailed.exchange(true))
+						spdlog::error("Live update: Failed to track a command queue. Replaced pipelines won't be released.");
+
+					return nullptr;
+				}
+
+				state = std::make_shared<QueueState>();
+				state->Queue = Queue;
+				state->Fence = std::move(fence);
+
+				UINT callbackId = 0;
+
+				if (FAILED(notifier->RegisterDestructionCallback(OnQueueDestroyed, state.get(), &callbackId)))
+				{
+					if (!QueueTrackingFailed.exchange(true))
+						spdlog::error("Live update: Failed to track a command queue. Replaced pipelines won't be released.");
+
+					return nullptr;
+				}
+
+				Queues.emplace_back(state);
+			}
+		}
+
+		seenQueues.emplace_back(Queue, state);
+		return state;
+	}
+
+	void WINAPI HookedD3D12CommandQueueExecuteCommandLists(
+		ID3D12CommandQueue *This,
+		UINT NumCommandLists,
+		ID3D12CommandList *const *ppCommandLists)
+	{
+		D3D12CommandQueueExecuteCommandLists(This, NumCommandLists, ppCommandLists);
+
+		if (auto state = TrackQueue(This))
+		{
+			// Values have to reach the queue in the order they're handed out. A failed signal never completes and the
+			// pipeline is leaked instead of released early.
+			std::scoped_lock lock(state->SignalLock);
+
+			const auto value = state->LastSignalledValue + 1;
+
+			if (SUCCEEDED(This->Signal(state->Fence.Get(), value)))
+				state->LastSignalledValue = value;
+		}
+	}
+
+	void Initialize(ID3D12Device2 *Device)
+	{
+		// Every queue shares one vtable. A temporary queue is enough to find it.
+		const D3D12_COMMAND_QUEUE_DESC queueDesc = {
+			.Type = D3D12_COMMAND_LIST_TYPE_DIRECT,
+			.Priority = D3D12_COMMAND_QUEUE_PRIORITY_NORMAL,
+			.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE,
+			.NodeMask = 0,
+		};
+		CComPtr<ID3D12CommandQueue> commandQueue;
+
+		if (FAILED(Device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&commandQueue))))
+		{
+			spdlog::error("Live update: Failed to hook the D3D12 command queue. Replaced pipelines won't be released.");
+			return;
+		}
+
+		const auto vtableBase = *reinterpret_cast<uintptr_t *>(commandQueue.Get());
+
+		QueueHookInstalled = Hooks::WriteVirtualFunction(
+			vtableBase,
+			10,
+			&HookedD3D12CommandQueueExecuteCommandLists,
+			&D3D12CommandQueueExecuteCommandLists);
+	}
+
+	uint64_t EstimatePipelineSize(const D3D12_PIPELINE_STATE_STREAM_DESC *Description)
+	{
+		// Drivers don't expose how much memory a pipeline uses. The size of its shaders is a decent estimate.
+		uint64_t size = 0;
+
+		for (D3DPipelineStateStream::Iterator iter(Description); !iter.AtEnd(); iter.Advance())
+		{
+			switch (auto obj = iter.GetObj(); obj->Type)
+			{
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_HS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_GS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_AS:
+			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_MS:
+				size += obj->Shader.BytecodeLength;
+				break;
+			}
+		}
+
+		return size;
+	}
+
+	void Retire(ID3D12PipelineState *PipelineState, uint64_t EstimatedSize)
+	{
+		if (!PipelineState)
+			return;
+
+		// Without fences there's no telling when the GPU is done with it. Leaking is the only safe option.
+		if (!QueueHookInstalled || QueueTrackingFailed)
+			return;
+
+		// The caller's reference is taken over
+		CComPtr<ID3D12PipelineState> pipelineState;
+		pipelineState.Attach(PipelineState);
+
+		std::scoped_lock lock(RetiredPipelinesLock);
+
+		RetiredPipelines.emplace_back(RetiredPipeline {
+			.PipelineState = std::move(pipelineState),
+			.EstimatedSize = EstimatedSize,
+			.RetiredFrame = FrameIndex,
+		});
+	}
+
+	void OnPresent()
+	{
+		std::vector<CComPtr<ID3D12PipelineState>> releasedPipelines;
+		uint64_t releasedSize = 0;
+		size_t totalCount = 0;
+		uint64_t totalSize = 0;
+
+		{
+			std::scoped_lock lock(RetiredPipelinesLock);
+			FrameIndex++;
+
+			if (RetiredPipelines.empty())
+				return;
+
+			auto isReadyToArm = [&](const RetiredPipeline& Pipeline)
+			{
+				return !Pipeline.Armed && FrameIndex >= Pipeline.RetiredFrame + FramesBeforeArming;
+			};
+
+			if (std::any_of(RetiredPipelines.begin(), RetiredPipelines.end(), isReadyToArm))
+			{
+				std::scoped_lock queuesLock(QueuesLock);
+
+				// Nothing was submitted yet. Wait for the game to show which queues it uses.
+				if (!Queues.empty())
+				{
+					// The last value handed out covers every submission made so far. Taking the signal lock keeps it
+					// from being read in between a signal and its value being published.
+					std::vector<std::pair<std::shared_ptr<QueueState>, uint64_t>> fenceWaits;
+
+					for (const auto& queue : Queues)
+					{
+						std::scoped_lock signalLock(queue->SignalLock);
+						fenceWaits.emplace_back(queue, queue->LastSignalledValue.load());
+					}
+
+					for (auto& pipeline : RetiredPipelines)
+					{
+						if (!isReadyToArm(pipeline))
+							continue;
+
+						pipeline.FenceWaits = fenceWaits;
+
+						pipeline.Armed = true;
+					}
+				}
+			}
+
+			std::erase_if(
+				RetiredPipelines,
+				[&](RetiredPipeline& Pipeline)
+				{
+					if (!Pipeline.Armed)
+						return false;
+
+					// A destroyed queue can't execute anything that still uses the pipeline
+					for (const auto& [queue, value] : Pipeline.FenceWaits)
+					{
+						if (!queue->Destroyed && queue->Fence->GetCompletedValue() < value)
+							return false;
+					}
+
+					releasedSize += Pipeline.EstimatedSize;
+					releasedPipelines.emplace_back(std::move(Pipeline.PipelineState));
+
+					return true;
+				});
+
+			if (releasedPipelines.empty())
+				return;
+
+			TotalReleasedCount += releasedPipelines.size();
+			TotalReleasedSize += releasedSize;
+
+			totalCount = TotalReleasedCount;
+			totalSize = TotalReleasedSize;
+		}
+
+		spdlog::info(
+			"Live update: Released {} replaced pipeline(s), about {:.1f} KB. {} released so far, about {:.1f} MB.",
+			releasedPipelines.size(),
+			releasedSize / 1024.0,
+			totalCount,
+			totalSize / (1024.0 * 1024.0));
+	}
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+namespace PipelineRetirement
+{
+	void Initialize(ID3D12Device2 *Device);
+	uint64_t EstimatePipelineSize(const D3D12_PIPELINE_STATE_STREAM_DESC *Description);
+	void Retire(ID3D12PipelineState *PipelineState, uint64_t EstimatedSize);
+	void OnPresent();
+}
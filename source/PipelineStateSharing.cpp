@@ -0,0 +1,74 @@
+#include "PipelineStateSharing.h"
+#include "Plugin.h"
+
+namespace PipelineStateSharing
+{
+	//
+	// Some techniques submit identical pipeline state streams. Pipelines with custom shaders are looked up by their
+	// stream fingerprint (see D3DPipelineStateStream::Fingerprint) and handed out again instead of being compiled a
+	// second time. Vanilla pipelines are left to the game's own library.
+	//
+	// Entries hold a reference so that lookups never race with destruction. Pipelines that nobody but this map
+	// refers to anymore are pruned whenever the map has doubled in size.
+	//
+	constexpr size_t MinimumPruneSize = 256;
+
+	std::mutex SharedPipelinesLock;
+	std::unordered_map<ShaderDigest::Hash, CComPtr<ID3D12PipelineState>, ShaderDigest::Hasher> SharedPipelines;
+	size_t NextPruneSize = MinimumPruneSize;
+	std::atomic_size_t AvoidedCompileCount;
+
+	ULONG GetReferenceCount(ID3D12PipelineState *PipelineState)
+	{
+		PipelineState->AddRef();
+		return PipelineState->Release();
+	}
+
+	void PruneUnusedPipelines()
+	{
+		const auto sizeBefore = SharedPipelines.size();
+
+		std::erase_if(
+			SharedPipelines,
+			[](const auto& Entry)
+			{
+				return GetReferenceCount(Entry.second.Get()) == 1;
+			});
+
+		NextPruneSize = std::max(MinimumPruneSize, SharedPipelines.size() * 2);
+		spdlog::trace("Pruned {} unused shared pipeline(s). {} remain.", sizeBefore - SharedPipelines.size(), SharedPipelines.size());
+	}
+
+	bool IsEnabled()
+	{
+		return Plugin::SharePipelineStates;
+	}
+
+	CComPtr<ID3D12PipelineState> Find(const ShaderDigest::Hash& Fingerprint)
+	{
+		std::scoped_lock lock(SharedPipelinesLock);
+		const auto itr = SharedPipelines.find(Fingerprint);
+
+		if (itr == SharedPipelines.end())
+			return nullptr;
+
+		AvoidedCompileCount++;
+		return itr->second;
+	}
+
+	void Register(const ShaderDigest::Hash& Fingerprint, ID3D12PipelineState *PipelineState)
+	{
+		std::scoped_lock lock(SharedPipelinesLock);
+
+		if (!SharedPipelines.try_emplace(Fingerprint, PipelineState).second)
+			return;
+
+		if (SharedPipelines.size() >= NextPruneSize)
+			PruneUnusedPipelines();
+	}
+
+	size_t GetAvoidedCompileCount()
+	{
+		return AvoidedCompileCount.load();
+	}
+}
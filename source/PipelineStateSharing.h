@@ -0,0 +1,12 @@
+#pragma once
+
+#include "CComPtr.h"
+#include "ShaderDigest.h"
+
+namespace PipelineStateSharing
+{
+	bool IsEnabled();
+	CComPtr<ID3D12PipelineState> Find(const ShaderDigest::Hash& Fingerprint);
+	void Register(const ShaderDigest::Hash& Fingerprint, ID3D12PipelineState *PipelineState);
+	size_t GetAvoidedCompileCount();
+}
@@ -0,0 +1,301 @@
+#include "PipelineTelemetry.h"
+#include "Plugin.h"
+#include "TelemetryHistogram.h"
+#include "TopList.h"
+
+namespace PipelineTelemetry
+{
+	//
+	// Pipelines are created from many game threads at once. Each thread writes samples into its own ring buffer
+	// without taking locks. Buffers are drained into the per-technique statistics by whichever thread reports, or by
+	// the owning thread once its buffer is half full.
+	//
+	class ThreadBuffer
+	{
+	private:
+		constexpr static size_t Capacity = 1024;
+
+		std::array<Sample, Capacity> m_Samples;
+		std::atomic_size_t m_Head = 0; // Only written by the owning thread
+		std::atomic_size_t m_Tail = 0; // Only written while AggregateLock is held
+
+	public:
+		bool Push(const Sample& Value)
+		{
+			const auto head = m_Head.load(std::memory_order_relaxed);
+
+			if (head - m_Tail.load(std::memory_order_acquire) >= Capacity)
+				return false;
+
+			m_Samples[head % Capacity] = Value;
+			m_Head.store(head + 1, std::memory_order_release);
+
+			return true;
+		}
+
+		bool IsHalfFull() const
+		{
+			return m_Head.load(std::memory_order_relaxed) - m_Tail.load(std::memory_order_relaxed) >= Capacity / 2;
+		}
+
+		template<typename F>
+		void Drain(F&& Callback)
+		{
+			const auto tail = m_Tail.load(std::memory_order_relaxed);
+			const auto head = m_Head.load(std::memory_order_acquire);
+
+			for (auto i = tail; i != head; i++)
+				Callback(m_Samples[i % Capacity]);
+
+			m_Tail.store(head, std::memory_order_release);
+		}
+	};
+
+	constexpr size_t TopListSize = 10;
+
+	struct TechniqueStatistics
+	{
+		const char *Name = nullptr;
+		bool Patched = false;
+		size_t Count = 0;
+		std::array<size_t, static_cast<size_t>(PipelineSource::Shared) + 1> SourceCounts = {};
+		uint64_t PatchTime = 0; // Microseconds
+		uint64_t LibraryTime = 0;
+		uint64_t CompileTime = 0;
+		uint32_t MaxTime = 0;
+		TelemetryHistogram::Histogram Histogram;
+
+		uint64_t GetTotalTime() const
+		{
+			return PatchTime + LibraryTime + CompileTime;
+		}
+	};
+
+	std::mutex BuffersLock;
+	std::vector<std::shared_ptr<ThreadBuffer>> Buffers; // Threads may exit before their samples are drained
+
+	std::mutex AggregateLock;
+	std::unordered_map<uint64_t, TechniqueStatistics> Techniques;
+	Summary Totals;
+
+	std::filesystem::path GetReportPath()
+	{
+		return Plugin::GetThisModulePath().parent_path() / BUILD_PROJECT_NAME ".telemetry.csv";
+	}
+
+	ThreadBuffer& GetThreadBuffer()
+	{
+		thread_local auto buffer = []()
+		{
+			auto newBuffer = std::make_shared<ThreadBuffer>();
+
+			std::scoped_lock lock(BuffersLock);
+			Buffers.emplace_back(newBuffer);
+
+			return newBuffer;
+		}();
+
+		return *buffer;
+	}
+
+	void Aggregate(const Sample& Value)
+	{
+		auto& stats = Techniques[Value.TechniqueId];
+		const auto totalTime = Value.PatchTime + Value.LibraryTime + Value.CompileTime;
+
+		stats.Name = Value.TechniqueName;
+		stats.Patched |= Value.Patched;
+		stats.Count++;
+		stats.SourceCounts[static_cast<size_t>(Value.Source)]++;
+		stats.PatchTime += Value.PatchTime;
+		stats.LibraryTime += Value.LibraryTime;
+		stats.CompileTime += Value.CompileTime;
+		stats.MaxTime = std::max(stats.MaxTime, totalTime);
+		stats.Histogram.Add(totalTime);
+
+		Totals.PipelineCount++;
+		Totals.TotalMilliseconds += totalTime / 1000.0;
+
+		if (Value.LibraryQueried)
+		{
+			const bool hit = Value.Source == PipelineSource::GameLibrary || Value.Source == PipelineSource::PatchedLibrary;
+
+			if (Value.Patched)
+				(hit ? Totals.PatchedLibraryHits : Totals.PatchedLibraryMisses)++;
+			else
+				(hit ? Totals.GameLibraryHits : Totals.GameLibraryMisses)++;
+		}
+	}
+
+	void DrainAll()
+	{
+		std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+
+		{
+			std::scoped_lock lock(BuffersLock);
+			buffers = Buffers;
+		}
+
+		for (auto& buffer : buffers)
+			buffer->Drain(Aggregate);
+	}
+
+	void WriteLog()
+	{
+		const auto hitRate = [](size_t Hits, size_t Misses)
+		{
+			return (Hits + Misses) > 0 ? (100.0 * Hits / (Hits + Misses)) : 0.0;
+		};
+
+		uint64_t patchTime = 0;
+		uint64_t libraryTime = 0;
+		uint64_t compileTime = 0;
+
+		for (const auto& [id, stats] : Techniques)
+		{
+			patchTime += stats.PatchTime;
+			libraryTime += stats.LibraryTime;
+			compileTime += stats.CompileTime;
+		}
+
+		spdlog::info(
+			"Pipeline telemetry: {} pipeline(s) in {:.1f} ms. Patching {:.1f} ms, library loads {:.1f} ms, driver compiles {:.1f} ms.",
+			Totals.PipelineCount,
+			Totals.TotalMilliseconds,
+			patchTime / 1000.0,
+			libraryTime / 1000.0,
+			compileTime / 1000.0);
+
+		spdlog::info(
+			"Pipeline telemetry: Game library {}/{} hits ({:.1f}%). Patched library {}/{} hits ({:.1f}%).",
+			Totals.GameLibraryHits,
+			Totals.GameLibraryHits + Totals.GameLibraryMisses,
+			hitRate(Totals.GameLibraryHits, Totals.GameLibraryMisses),
+			Totals.PatchedLibraryHits,
+			Totals.PatchedLibraryHits + Totals.PatchedLibraryMisses,
+			hitRate(Totals.PatchedLibraryHits, Totals.PatchedLibraryMisses));
+
+		std::vector<std::pair<uint64_t, const TechniqueStatistics *>> slowest;
+
+		for (const auto& [id, stats] : Techniques)
+			slowest.emplace_back(id, &stats);
+
+		const auto top = TopList::SelectLargest(
+			std::span(slowest),
+			TopListSize,
+			[](const std::pair<uint64_t, const TechniqueStatistics *>& Entry)
+			{
+				return Entry.second->GetTotalTime();
+			});
+
+		for (size_t i = 0; i < top.size(); i++)
+		{
+			const auto& [id, stats] = top[i];
+
+			spdlog::info(
+				"Pipeline telemetry: #{} {} ({:X}): {:.1f} ms over {} pipeline(s), slowest {:.1f} ms.",
+				i + 1,
+				stats->Name ? stats->Name : "",
+				id,
+				stats->GetTotalTime() / 1000.0,
+				stats->Count,
+				stats->MaxTime / 1000.0);
+		}
+	}
+
+	void WriteCSV()
+	{
+		const auto path = GetReportPath();
+		std::ofstream f(path, std::ios::trunc);
+
+		if (!f.good())
+		{
+			spdlog::error("Failed to write pipeline telemetry: {}", path.string());
+			return;
+		}
+
+		f << "TechniqueId,TechniqueName,Patched,Count,Compiled,GameLibrary,PatchedLibrary,Prewarmed,Shared,PatchMs,LibraryMs,CompileMs,"
+			 "TotalMs,MaxMs";
+
+		for (const auto bound : TelemetryHistogram::BucketBounds)
+			f << ",UpTo" << bound / 1000.0 << "Ms";
+
+		f << ",Over" << TelemetryHistogram::BucketBounds.back() / 1000.0 << "Ms\n";
+
+		for (const auto& [id, stats] : Techniques)
+		{
+			char csvLine[512];
+			sprintf_s(
+				csvLine,
+				"%llX,\"%s\",%d,%zu,%zu,%zu,%zu,%zu,%zu,%.3f,%.3f,%.3f,%.3f,%.3f",
+				static_cast<unsigned long long>(id),
+				stats.Name ? stats.Name : "",
+				stats.Patched ? 1 : 0,
+				stats.Count,
+				stats.SourceCounts[static_cast<size_t>(PipelineSource::Compiled)],
+				stats.SourceCounts[static_cast<size_t>(PipelineSource::GameLibrary)],
+				stats.SourceCounts[static_cast<size_t>(PipelineSource::PatchedLibrary)],
+				stats.SourceCounts[static_cast<size_t>(PipelineSource::Prewarmed)],
+				stats.SourceCounts[static_cast<size_t>(PipelineSource::Shared)],
+				stats.PatchTime / 1000.0,
+				stats.LibraryTime / 1000.0,
+				stats.CompileTime / 1000.0,
+				stats.GetTotalTime() / 1000.0,
+				stats.MaxTime / 1000.0);
+
+			f << csvLine;
+
+			for (const auto count : stats.Histogram.GetCounts())
+				f << ',' << count;
+
+			f << '\n';
+		}
+
+		spdlog::info("Wrote pipeline telemetry: {}", path.string());
+	}
+
+	bool IsEnabled()
+	{
+		return Plugin::PipelineTelemetry;
+	}
+
+	void Record(const Sample& Sample)
+	{
+		if (!IsEnabled())
+			return;
+
+		auto& buffer = GetThreadBuffer();
+
+		// Drain opportunistically so that loading screens don't fill the buffer. Only a full buffer has to wait for
+		// another thread that's draining.
+		if (!buffer.Push(Sample))
+		{
+			std::scoped_lock lock(AggregateLock);
+
+			buffer.Drain(Aggregate);
+			buffer.Push(Sample);
+		}
+		else if (buffer.IsHalfFull())
+		{
+			if (std::unique_lock lock(AggregateLock, std::try_to_lock); lock.owns_lock())
+				buffer.Drain(Aggregate);
+		}
+	}
+
+	Summary GetSummary()
+	{
+		std::scoped_lock lock(AggregateLock);
+		DrainAll();
+
+		return Totals;
+	}
+
+	void Report()
+	{
+		std::scoped_lock lock(AggregateLock);
+		DrainAll();
+
+		WriteLog();
+		WriteCSV();
+	}
+}
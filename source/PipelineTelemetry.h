@@ -0,0 +1,57 @@
+#pragma once
+
+namespace PipelineTelemetry
+{
+	enum class PipelineSource : uint8_t
+	{
+		Compiled,
+		GameLibrary,
+		PatchedLibrary,
+		Prewarmed,
+		Shared,
+	};
+
+	struct Sample
+	{
+		uint64_t TechniqueId = 0;
+		const char *TechniqueName = nullptr; // Has to outlive the plugin, e.g. names from the game's technique table
+		uint32_t PatchTime = 0;				 // Microseconds
+		uint32_t LibraryTime = 0;
+		uint32_t CompileTime = 0;
+		PipelineSource Source = PipelineSource::Compiled;
+		bool Patched = false;
+		bool LibraryQueried = false;
+	};
+
+	struct Summary
+	{
+		size_t PipelineCount = 0;
+		size_t GameLibraryHits = 0;
+		size_t GameLibraryMisses = 0;
+		size_t PatchedLibraryHits = 0;
+		size_t PatchedLibraryMisses = 0;
+		double TotalMilliseconds = 0;
+	};
+
+	class Stopwatch
+	{
+	private:
+		std::chrono::steady_clock::time_point m_Last = std::chrono::steady_clock::now();
+
+	public:
+		// Microseconds since construction or the previous call
+		uint32_t Lap()
+		{
+			const auto now = std::chrono::steady_clock::now();
+			const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - m_Last).count();
+			m_Last = now;
+
+			return static_cast<uint32_t>(std::min<int64_t>(elapsed, UINT32_MAX));
+		}
+	};
+
+	bool IsEnabled();
+	void Record(const Sample& Sample);
+	Summary GetSummary();
+	void Report();
+}
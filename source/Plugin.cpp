@@ -1,13 +1,34 @@
 #include <spdlog/sinks/basic_file_sink.h>
 #include <toml++/toml.h>
 #include <ShlObj.h>
+#include "D3DShaderReplacement.h"
+#include "PipelineTelemetry.h"
 #include "Plugin.h"
+#include "ShaderDumpWriter.h"
 
 namespace Plugin
 {
 	bool AllowLiveUpdates = false;
+	uint32_t LiveUpdateSwapsPerFrame = 0;
 	bool InsertDebugMarkers = false;
+	bool PipelineTelemetry = false;
+	uint32_t HitchThresholdMs = 0;
 	std::filesystem::path ShaderDumpBinPath;
+	bool ShaderDumpLooseFiles = true;
+	bool ShaderDumpHardlinks = true;
+	std::string ShaderDumpIncludeTechniques;
+	std::string ShaderDumpExcludeTechniques;
+	std::string ShaderDumpTechniqueIds;
+	std::string ShaderDumpStages;
+	std::vector<std::filesystem::path> ShaderOverlayPaths;
+	bool ValidateCustomShaders = true;
+	uint32_t ShaderCacheSizeMB = 256;
+	bool DecompressBundlesAtStartup = true;
+	bool PrefetchShaders = true;
+	bool StripCustomShaders = true;
+	bool CachePatchedPipelines = true;
+	bool PrewarmPatchedPipelines = true;
+	bool SharePipelineStates = true;
 
 	bool Initialize(bool UseASI)
 	{
@@ -16,6 +37,8 @@ namespace Plugin
 		if (!InitializeLog(UseASI))
 			return false;
 
+		D3DShaderReplacement::Initialize();
+
 		if (!Offsets::Initialize())
 			return false;
 
@@ -71,8 +94,42 @@ namespace Plugin
 			if (toml.get("Development"))
 			{
 				AllowLiveUpdates = toml["Development"]["AllowLiveUpdates"].value_or(false);
+				LiveUpdateSwapsPerFrame = toml["Development"]["LiveUpdateSwapsPerFrame"].value_or(0u);
 				InsertDebugMarkers = toml["Development"]["InsertDebugMarkers"].value_or(false);
+				PipelineTelemetry = toml["Development"]["PipelineTelemetry"].value_or(false);
+				HitchThresholdMs = toml["Development"]["HitchThresholdMs"].value_or(0u);
 				ShaderDumpBinPath = toml["Development"]["ShaderDumpBinPath"].value_or(L"");
+				ShaderDumpLooseFiles = toml["Development"]["ShaderDumpLooseFiles"].value_or(true);
+				ShaderDumpHardlinks = toml["Development"]["ShaderDumpHardlinks"].value_or(true);
+				ShaderDumpIncludeTechniques = toml["Development"]["ShaderDumpIncludeTechniques"].value_or(std::string());
+				ShaderDumpExcludeTechniques = toml["Development"]["ShaderDumpExcludeTechniques"].value_or(std::string());
+				ShaderDumpTechniqueIds = toml["Development"]["ShaderDumpTechniqueIds"].value_or(std::string());
+				ShaderDumpStages = toml["Development"]["ShaderDumpStages"].value_or(std::string());
+			}
+
+			if (toml.get("Shaders"))
+			{
+				if (auto overlays = toml["Shaders"]["OverlayPaths"].as_array())
+				{
+					for (const auto& overlay : *overlays)
+					{
+						if (auto path = overlay.value_or(L""); !path.empty())
+							ShaderOverlayPaths.emplace_back(std::move(path));
+					}
+				}
+
+				ValidateCustomShaders = toml["Shaders"]["ValidateCustomShaders"].value_or(true);
+			}
+
+			if (toml.get("Performance"))
+			{
+				ShaderCacheSizeMB = toml["Performance"]["ShaderCacheSizeMB"].value_or(256u);
+				DecompressBundlesAtStartup = toml["Performance"]["DecompressBundlesAtStartup"].value_or(true);
+				PrefetchShaders = toml["Performance"]["PrefetchShaders"].value_or(true);
+				StripCustomShaders = toml["Performance"]["StripCustomShaders"].value_or(true);
+				CachePatchedPipelines = toml["Performance"]["CachePatchedPipelines"].value_or(true);
+				PrewarmPatchedPipelines = toml["Performance"]["PrewarmPatchedPipelines"].value_or(true);
+				SharePipelineStates = toml["Performance"]["SharePipelineStates"].value_or(true);
 			}
 
 			if (!ShaderDumpBinPath.empty())
@@ -86,6 +143,39 @@ namespace Plugin
 		return true;
 	}
 
+	void Shutdown()
+	{
+		// Runs while the game is exiting but before its threads are torn down. DLL detach is too late for that since
+		// every other thread is already gone and the loader lock is held.
+		static bool once = []()
+		{
+			ShaderDumpWriter::Shutdown();
+
+			if (PipelineTelemetry::IsEnabled())
+				PipelineTelemetry::Report();
+
+			return true;
+		}();
+	}
+
+	void(WINAPI *KernelExitProcess)(UINT);
+	void WINAPI HookedExitProcess(UINT ExitCode)
+	{
+		Shutdown();
+		KernelExitProcess(ExitCode);
+	}
+
+	DECLARE_HOOK_TRANSACTION(Plugin)
+	{
+		if (!Hooks::RedirectImport(
+				nullptr,
+				"kernel32.dll",
+				"ExitProcess",
+				reinterpret_cast<const void *>(&HookedExitProcess),
+				reinterpret_cast<void **>(&KernelExitProcess)))
+			spdlog::warn("The game doesn't import ExitProcess. Pending work won't be flushed on exit.");
+	};
+
 	void *GetThisModuleHandle()
 	{
 		HMODULE dllHandle = nullptr;
@@ -97,6 +187,14 @@ namespace Plugin
 
 		return dllHandle;
 	}
+
+	std::filesystem::path GetThisModulePath()
+	{
+		wchar_t dllPath[1024] = {};
+		GetModuleFileNameW(static_cast<HMODULE>(GetThisModuleHandle()), dllPath, static_cast<uint32_t>(std::size(dllPath)));
+
+		return dllPath;
+	}
 }
 
 #if BUILD_FOR_SFSE
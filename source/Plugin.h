@@ -3,11 +3,31 @@
 namespace Plugin
 {
 	extern bool AllowLiveUpdates;
+	extern uint32_t LiveUpdateSwapsPerFrame;
 	extern bool InsertDebugMarkers;
+	extern bool PipelineTelemetry;
+	extern uint32_t HitchThresholdMs;
 	extern std::filesystem::path ShaderDumpBinPath;
+	extern bool ShaderDumpLooseFiles;
+	extern bool ShaderDumpHardlinks;
+	extern std::string ShaderDumpIncludeTechniques;
+	extern std::string ShaderDumpExcludeTechniques;
+	extern std::string ShaderDumpTechniqueIds;
+	extern std::string ShaderDumpStages;
+	extern std::vector<std::filesystem::path> ShaderOverlayPaths;
+	extern bool ValidateCustomShaders;
+	extern uint32_t ShaderCacheSizeMB;
+	extern bool DecompressBundlesAtStartup;
+	extern bool PrefetchShaders;
+	extern bool StripCustomShaders;
+	extern bool CachePatchedPipelines;
+	extern bool PrewarmPatchedPipelines;
+	extern bool SharePipelineStates;
 
 	bool Initialize(bool UseASI);
 	bool InitializeLog(bool UseASI);
 	bool InitializeSettings();
+	void Shutdown();
 	void *GetThisModuleHandle();
+	std::filesystem::path GetThisModulePath();
 }
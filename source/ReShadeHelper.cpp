@@ -1,6 +1,7 @@
 #include <reshade-imgui/imgui.h>
 #include "RE/CreationRenderer.h"
 #include "CComPtr.h"
+#include "PipelineTelemetry.h"
 #include "Plugin.h"
 #include "ReShadeHelper.h"
 
@@ -206,6 +207,23 @@ namespace ReShadeHelper
 
 		if (updated)
 			effectConfig->Save(Runtime);
+
+		if (PipelineTelemetry::IsEnabled())
+		{
+			const auto summary = PipelineTelemetry::GetSummary();
+
+			ImGui::Separator();
+			ImGui::Text("Pipelines created: %zu (%.1f ms)", summary.PipelineCount, summary.TotalMilliseconds);
+			ImGui::Text(
+				"Library hits: game %zu/%zu, patched %zu/%zu",
+				summary.GameLibraryHits,
+				summary.GameLibraryHits + summary.GameLibraryMisses,
+				summary.PatchedLibraryHits,
+				summary.PatchedLibraryHits + summary.PatchedLibraryMisses);
+
+			if (ImGui::Button("Write pipeline telemetry"))
+				PipelineTelemetry::Report();
+		}
 	}
 
 	void Initialize()
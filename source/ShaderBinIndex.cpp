@@ -0,0 +1,417 @@
+#include <execution>
+#include <shared_mutex>
+#include "D3DShaderReplacement.h"
+#include "DXContainer.h"
+#include "Plugin.h"
+#include "ShaderBinIndex.h"
+#include "ShaderPaths.h"
+
+namespace ShaderBinIndex
+{
+	// Technique short names are stored in lowercase. Windows file names are case insensitive and the old per-shader
+	// file probing relied on that.
+	struct KeyView
+	{
+		std::string_view TechniqueShortName;
+		uint64_t TechniqueId = 0;
+		D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type = {};
+
+		bool operator==(const KeyView& Other) const = default;
+	};
+
+	struct Key
+	{
+		std::string TechniqueShortName;
+		uint64_t TechniqueId = 0;
+		D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type = {};
+
+		operator KeyView() const
+		{
+			return { TechniqueShortName, TechniqueId, Type };
+		}
+	};
+
+	struct KeyHasher
+	{
+		using is_transparent = void;
+
+		size_t operator()(const KeyView& Key) const
+		{
+			const auto idHash = (Key.TechniqueId ^ (static_cast<uint64_t>(Key.Type) << 56)) * 0x9E3779B97F4A7C15ull;
+			return std::hash<std::string_view>()(Key.TechniqueShortName) ^ static_cast<size_t>(idHash);
+		}
+	};
+
+	struct KeyEqual
+	{
+		using is_transparent = void;
+
+		bool operator()(const KeyView& A, const KeyView& B) const
+		{
+			return A == B;
+		}
+	};
+
+	std::shared_mutex IndexLock;
+	std::unordered_map<Key, Entry, KeyHasher, KeyEqual> Index;
+	std::unordered_map<ShaderDigest::Hash, Entry, ShaderDigest::Hasher> ContainerDigestIndex;
+	std::atomic_uint64_t Generation; // Incremented on every rebuild
+
+	std::optional<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE> GetTypeFromPrefix(std::string_view Prefix)
+	{
+		for (const auto type : {
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_HS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_GS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_AS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_MS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE,
+			 })
+		{
+			if (Prefix == D3DShaderReplacement::GetShaderTypePrefix(type))
+				return type;
+		}
+
+		return std::nullopt;
+	}
+
+	bool ParseShaderBinFileName(std::string_view FileName, std::string_view DirectoryName, Key& Out)
+	{
+		ShaderPaths::ShaderFileName fileName;
+
+		if (!ShaderPaths::ParseShaderBinFileName(FileName, DirectoryName, fileName))
+			return false;
+
+		const auto type = GetTypeFromPrefix(ShaderBundleFormat::StagePrefixes[static_cast<size_t>(fileName.Stage)]);
+
+		if (!type)
+			return false;
+
+		Out.TechniqueShortName = std::move(fileName.TechniqueShortName);
+		Out.TechniqueId = fileName.TechniqueId;
+		Out.Type = *type;
+
+		return true;
+	}
+
+	void LoadBundle(const std::filesystem::path& BundlePath, decltype(Index)& Output)
+	{
+		// Bundles stay mapped for as long as any entry or pipeline references them. Live updates read a private copy
+		// so the bundle can be rebuilt in place.
+		const auto bundle = ShaderBlob::LoadFile(BundlePath, !Plugin::AllowLiveUpdates);
+
+		if (!bundle)
+		{
+			spdlog::error("Failed to open shader bundle: {}", BundlePath.string());
+			return;
+		}
+
+		const auto data = bundle->GetData();
+		std::vector<ShaderBundleFormat::ParsedEntry> entries;
+		size_t skippedEntries = 0;
+
+		if (!ShaderBundleFormat::Parse(data, entries, skippedEntries))
+		{
+			spdlog::error("Shader bundle is malformed or uses an unsupported version: {}", BundlePath.string());
+			return;
+		}
+
+		std::error_code ec;
+		const auto bundleWriteTime = std::filesystem::last_write_time(BundlePath, ec);
+		std::vector<std::pair<Key, Entry>> bundleEntries;
+
+		bundleEntries.reserve(entries.size());
+
+		for (const auto& entry : entries)
+		{
+			const auto type = GetTypeFromPrefix(ShaderBundleFormat::StagePrefixes[static_cast<size_t>(entry.Info->ShaderStage)]);
+
+			if (!type)
+			{
+				skippedEntries++;
+				continue;
+			}
+
+			Key key {
+				.TechniqueShortName = std::string(entry.TechniqueShortName),
+				.TechniqueId = entry.Info->TechniqueId,
+				.Type = *type,
+			};
+
+			Entry indexEntry {
+				.Path = BundlePath,
+				.FileSize = entry.Info->UncompressedSize,
+				.LastWriteTime = bundleWriteTime,
+				.BundleData = std::make_shared<const ShaderBlob::Blob>(bundle, entry.Data),
+				.BundleDigest = entry.Info->Digest,
+				.BundleCompression = entry.Info->BlobCompression,
+				.BundleUncompressedSize = entry.Info->UncompressedSize,
+			};
+
+			bundleEntries.emplace_back(std::move(key), std::move(indexEntry));
+		}
+
+		// Compressed blobs are either expanded here on all cores or left for the blob cache to expand on first use
+		if (Plugin::DecompressBundlesAtStartup)
+		{
+			std::atomic_size_t failedEntries = 0;
+
+			std::for_each(
+				std::execution::par,
+				bundleEntries.begin(),
+				bundleEntries.end(),
+				[&](std::pair<Key, Entry>& Pair)
+				{
+					auto& entry = Pair.second;
+
+					if (entry.BundleCompression == ShaderBundleFormat::Compression::None)
+						return;
+
+					entry.BundleData = ShaderBlob::DecompressLZ4(entry.BundleData->GetData(), entry.BundleUncompressedSize);
+					entry.BundleCompression = ShaderBundleFormat::Compression::None;
+
+					if (!entry.BundleData)
+					{
+						failedEntries++;
+						return;
+					}
+
+					// Heap copies are stripped right away instead of keeping both versions around
+					if (!Plugin::StripCustomShaders)
+						return;
+
+					if (auto stripped = ShaderBlob::StripNonRuntimeParts(entry.BundleData->GetData()))
+					{
+						const auto data = stripped->GetData();
+
+						entry.BundleData = std::move(stripped);
+						entry.BundleDigest = ShaderDigest::Compute(data.data(), data.size());
+						entry.BundleUncompressedSize = data.size();
+					}
+				});
+
+			if (failedEntries > 0)
+			{
+				std::erase_if(
+					bundleEntries,
+					[](const auto& Pair)
+					{
+						return !Pair.second.BundleData;
+					});
+
+				skippedEntries += failedEntries;
+			}
+		}
+
+		for (auto& [key, entry] : bundleEntries)
+			Output.insert_or_assign(std::move(key), std::move(entry));
+
+		if (skippedEntries > 0)
+			spdlog::warn("Skipped {} malformed entries in shader bundle: {}", skippedEntries, BundlePath.string());
+
+		spdlog::info("Loaded {} shader(s) from bundle: {}", bundleEntries.size(), BundlePath.string());
+	}
+
+	void LoadContainerDigestDirectory(const std::filesystem::path& Directory, decltype(ContainerDigestIndex)& Output)
+	{
+		// "<Root>/ByHash/<Digest>.bin"
+		std::error_code ec;
+
+		for (std::filesystem::directory_iterator itr(Directory, ec), end; !ec && itr != end; itr.increment(ec))
+		{
+			const auto fileName = ShaderPaths::ToLowerAscii<std::filesystem::path::value_type>(itr->path().filename().native());
+
+			if (!fileName || !fileName->ends_with(".bin"))
+				continue;
+
+			const auto digest = DXContainer::DigestFromString(std::string_view(*fileName).substr(0, fileName->size() - 4));
+
+			if (!digest)
+				continue;
+
+			std::error_code attributeEc;
+			Entry entry {
+				.Path = itr->path(),
+				.FileSize = itr->file_size(attributeEc),
+				.LastWriteTime = itr->last_write_time(attributeEc),
+			};
+
+			if (!attributeEc)
+				Output.insert_or_assign(*digest, std::move(entry));
+		}
+	}
+
+	void BuildLayer(const std::filesystem::path& RootDirectory, decltype(Index)& Output, decltype(ContainerDigestIndex)& DigestOutput)
+	{
+		// Only the top level is walked serially. Each technique folder is scanned on its own thread since large shader
+		// mods can ship thousands of files.
+		std::vector<std::filesystem::path> techniqueDirectories;
+		std::vector<std::filesystem::path> bundles;
+		std::error_code ec;
+
+		for (std::filesystem::directory_iterator itr(RootDirectory, ec), end; !ec && itr != end; itr.increment(ec))
+		{
+			std::error_code typeEc;
+
+			if (itr->is_directory(typeEc))
+			{
+				const auto name = ShaderPaths::ToLowerAscii<std::filesystem::path::value_type>(itr->path().filename().native());
+
+				if (name == ShaderPaths::ContainerDigestDirectoryName)
+					LoadContainerDigestDirectory(itr->path(), DigestOutput);
+				else
+					techniqueDirectories.emplace_back(itr->path());
+			}
+			else if (auto name = ShaderPaths::ToLowerAscii<std::filesystem::path::value_type>(itr->path().filename().native());
+					 name && name->ends_with(ShaderBundleFormat::FileExtension))
+				bundles.emplace_back(itr->path());
+		}
+
+		// Bundles are applied in file name order with later bundles taking priority. Loose files take priority
+		// over all bundles so that they can be iterated on.
+		std::mutex outputLock;
+
+		std::sort(bundles.begin(), bundles.end());
+
+		for (const auto& bundle : bundles)
+			LoadBundle(bundle, Output);
+
+		std::for_each(
+			std::execution::par,
+			techniqueDirectories.begin(),
+			techniqueDirectories.end(),
+			[&](const std::filesystem::path& Directory)
+			{
+				const auto directoryName = ShaderPaths::ToLowerAscii<std::filesystem::path::value_type>(Directory.filename().native());
+
+				if (!directoryName)
+					return;
+
+				std::vector<std::pair<Key, Entry>> entries;
+				std::error_code ec;
+
+				for (std::filesystem::directory_iterator itr(Directory, ec), end; !ec && itr != end; itr.increment(ec))
+				{
+					const auto fileName = ShaderPaths::ToLowerAscii<std::filesystem::path::value_type>(itr->path().filename().native());
+					Key key;
+
+					if (!fileName || !ParseShaderBinFileName(*fileName, *directoryName, key))
+						continue;
+
+					// Directory entries cache the attributes returned by the enumeration. No extra file system calls.
+					std::error_code attributeEc;
+					Entry entry {
+						.Path = itr->path(),
+						.FileSize = itr->file_size(attributeEc),
+						.LastWriteTime = itr->last_write_time(attributeEc),
+					};
+
+					if (!attributeEc)
+						entries.emplace_back(std::move(key), std::move(entry));
+				}
+
+				std::scoped_lock lock(outputLock);
+
+				for (auto& [key, entry] : entries)
+					Output.insert_or_assign(std::move(key), std::move(entry));
+			});
+	}
+
+	void Build(std::span<const std::filesystem::path> RootDirectories)
+	{
+		// Layers are merged in order. Anything in a later layer replaces the same shader from earlier layers, so
+		// lookups stay a single probe regardless of how many layers exist.
+		decltype(Index) newIndex;
+		decltype(ContainerDigestIndex) newContainerDigestIndex;
+
+		for (const auto& root : RootDirectories)
+			BuildLayer(root, newIndex, newContainerDigestIndex);
+
+		if (!newContainerDigestIndex.empty())
+			spdlog::info("Indexed {} custom shader file(s) by container hash.", newContainerDigestIndex.size());
+
+		std::unique_lock lock(IndexLock);
+		Index = std::move(newIndex);
+		ContainerDigestIndex = std::move(newContainerDigestIndex);
+		Generation++;
+	}
+
+	uint64_t GetGeneration()
+	{
+		return Generation.load();
+	}
+
+	size_t GetEntryCount()
+	{
+		std::shared_lock lock(IndexLock);
+		return Index.size() + ContainerDigestIndex.size();
+	}
+
+	bool HasTechniqueEntries()
+	{
+		std::shared_lock lock(IndexLock);
+		return !Index.empty();
+	}
+
+	std::vector<Entry> GetEntries()
+	{
+		std::shared_lock lock(IndexLock);
+		std::vector<Entry> entries;
+
+		entries.reserve(Index.size() + ContainerDigestIndex.size());
+
+		for (const auto& [key, entry] : Index)
+			entries.emplace_back(entry);
+
+		for (const auto& [digest, entry] : ContainerDigestIndex)
+			entries.emplace_back(entry);
+
+		return entries;
+	}
+
+	std::optional<Entry> LookupByContainerDigest(const ShaderDigest::Hash& Digest)
+	{
+		std::shared_lock lock(IndexLock);
+
+		if (auto itr = ContainerDigestIndex.find(Digest); itr != ContainerDigestIndex.end())
+			return itr->second;
+
+		return std::nullopt;
+	}
+
+	std::optional<Entry> Lookup(std::string_view TechniqueShortName, uint64_t TechniqueId, D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type)
+	{
+		char lowercaseName[512];
+
+		if (TechniqueShortName.size() >= std::size(lowercaseName))
+			return std::nullopt;
+
+		std::transform(
+			TechniqueShortName.begin(),
+			TechniqueShortName.end(),
+			lowercaseName,
+			[](char C)
+			{
+				return (C >= 'A' && C <= 'Z') ? static_cast<char>(C - 'A' + 'a') : C;
+			});
+
+		const KeyView key {
+			.TechniqueShortName = { lowercaseName, TechniqueShortName.size() },
+			.TechniqueId = TechniqueId,
+			.Type = Type,
+		};
+
+		std::shared_lock lock(IndexLock);
+
+		if (Index.empty())
+			return std::nullopt;
+
+		if (auto itr = Index.find(key); itr != Index.end())
+			return itr->second;
+
+		return std::nullopt;
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "ShaderBlob.h"
+#include "ShaderBundleFormat.h"
+#include "ShaderDigest.h"
+
+namespace ShaderBinIndex
+{
+	struct Entry
+	{
+		std::filesystem::path Path;
+		uint64_t FileSize = 0;
+		std::filesystem::file_time_type LastWriteTime;
+
+		// Only set for shaders packed in a bundle. Path then refers to the bundle itself. BundleData holds compressed
+		// bytes until it's decompressed by the blob cache.
+		std::shared_ptr<const ShaderBlob::Blob> BundleData;
+		ShaderDigest::Hash BundleDigest;
+		ShaderBundleFormat::Compression BundleCompression = ShaderBundleFormat::Compression::None;
+		uint64_t BundleUncompressedSize = 0;
+	};
+
+	void Build(std::span<const std::filesystem::path> RootDirectories);
+	uint64_t GetGeneration();
+	size_t GetEntryCount();
+	bool HasTechniqueEntries();
+	std::vector<Entry> GetEntries();
+
+	std::optional<Entry> LookupByContainerDigest(const ShaderDigest::Hash& Digest);
+	std::optional<Entry> Lookup(std::string_view TechniqueShortName, uint64_t TechniqueId, D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type);
+}
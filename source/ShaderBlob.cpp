@@ -0,0 +1,204 @@
+#include <lz4.h>
+#include "DXContainer.h"
+#include "ShaderBlob.h"
+
+namespace ShaderBlob
+{
+	// Distinguishes a file that was rebuilt in place from the one that's already mapped under the same path
+	struct FileIdentity
+	{
+		uint32_t VolumeSerialNumber = 0;
+		uint64_t FileIndex = 0;
+		uint64_t LastWriteTime = 0;
+		uint64_t Size = 0;
+
+		bool operator==(const FileIdentity& Other) const = default;
+	};
+
+	struct MappedFile
+	{
+		FileIdentity Identity;
+		std::weak_ptr<const Blob> Blob;
+	};
+
+	std::mutex MappedFilesLock;
+	std::unordered_map<std::filesystem::path, MappedFile> MappedFiles;
+
+	Blob::Blob(void *MappedView, size_t Size) : m_MappedView(MappedView)
+	{
+		m_Data = { static_cast<const uint8_t *>(MappedView), Size };
+	}
+
+	Blob::Blob(std::unique_ptr<uint8_t[]>&& HeapData, size_t Size) : m_HeapData(std::move(HeapData))
+	{
+		m_Data = { m_HeapData.get(), Size };
+	}
+
+	Blob::Blob(std::shared_ptr<const Blob> Parent, std::span<const uint8_t> Range) : m_Data(Range), m_Parent(std::move(Parent))
+	{
+	}
+
+	Blob::~Blob()
+	{
+		if (m_MappedView)
+			UnmapViewOfFile(m_MappedView);
+	}
+
+	void Blob::PrefetchPages() const
+	{
+		// Asks the memory manager to page in mapped data ahead of time. Heap copies are already resident.
+		if (!IsMapped() || m_Data.empty())
+			return;
+
+		WIN32_MEMORY_RANGE_ENTRY range {
+			.VirtualAddress = const_cast<uint8_t *>(m_Data.data()),
+			.NumberOfBytes = m_Data.size(),
+		};
+
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+	}
+
+	bool GetFileIdentity(HANDLE FileHandle, FileIdentity& Identity)
+	{
+		BY_HANDLE_FILE_INFORMATION info = {};
+
+		if (!GetFileInformationByHandle(FileHandle, &info))
+			return false;
+
+		Identity = {
+			.VolumeSerialNumber = info.dwVolumeSerialNumber,
+			.FileIndex = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow,
+			.LastWriteTime = (static_cast<uint64_t>(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime,
+			.Size = (static_cast<uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow,
+		};
+
+		return true;
+	}
+
+	std::shared_ptr<const Blob> MapFile(HANDLE FileHandle, uint64_t FileSize)
+	{
+		// Zero length files can't be mapped and aren't valid shaders anyway
+		if (FileSize == 0)
+			return nullptr;
+
+		const auto mappingHandle = CreateFileMappingW(FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+		if (!mappingHandle)
+			return nullptr;
+
+		// The view keeps the section alive after both handles are closed
+		const auto view = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mappingHandle);
+
+		if (!view)
+			return nullptr;
+
+		return std::make_shared<const Blob>(view, static_cast<size_t>(FileSize));
+	}
+
+	std::shared_ptr<const Blob> ReadFileToHeap(const std::filesystem::path& Path)
+	{
+		std::ifstream f(Path, std::ios::binary | std::ios::ate);
+
+		if (!f.good())
+			return nullptr;
+
+		const auto fileSize = static_cast<size_t>(f.tellg());
+		auto fileData = std::make_unique<uint8_t[]>(fileSize);
+
+		f.seekg(0, std::ios::beg);
+		f.read(reinterpret_cast<char *>(fileData.get()), fileSize);
+
+		if (!f.good())
+			return nullptr;
+
+		return std::make_shared<const Blob>(std::move(fileData), fileSize);
+	}
+
+	std::shared_ptr<const Blob> LoadFile(const std::filesystem::path& Path, bool AllowMapping)
+	{
+		// Mapped files can't be truncated or rewritten by other processes. Callers disable mapping when files are
+		// expected to change, i.e. live updates, and get a private heap copy instead.
+		if (!AllowMapping)
+			return ReadFileToHeap(Path);
+
+		const auto fileHandle = CreateFileW(
+			Path.c_str(),
+			GENERIC_READ,
+			FILE_SHARE_READ | FILE_SHARE_DELETE,
+			nullptr,
+			OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL,
+			nullptr);
+
+		if (fileHandle == INVALID_HANDLE_VALUE)
+			return nullptr;
+
+		FileIdentity identity;
+
+		if (!GetFileIdentity(fileHandle, identity))
+		{
+			CloseHandle(fileHandle);
+			return nullptr;
+		}
+
+		std::scoped_lock lock(MappedFilesLock);
+
+		if (auto itr = MappedFiles.find(Path); itr != MappedFiles.end() && itr->second.Identity == identity)
+		{
+			if (auto blob = itr->second.Blob.lock())
+			{
+				CloseHandle(fileHandle);
+				return blob;
+			}
+		}
+
+		auto blob = MapFile(fileHandle, identity.Size);
+		CloseHandle(fileHandle);
+
+		if (blob)
+		{
+			std::erase_if(
+				MappedFiles,
+				[](const auto& Pair)
+				{
+					return Pair.second.Blob.expired();
+				});
+
+			MappedFiles.insert_or_assign(Path, MappedFile { .Identity = identity, .Blob = blob });
+		}
+
+		return blob;
+	}
+
+	std::shared_ptr<const Blob> DecompressLZ4(std::span<const uint8_t> Source, size_t UncompressedSize)
+	{
+		if (Source.size() > LZ4_MAX_INPUT_SIZE || UncompressedSize == 0 || UncompressedSize > INT_MAX)
+			return nullptr;
+
+		auto data = std::make_unique<uint8_t[]>(UncompressedSize);
+		const auto result = LZ4_decompress_safe(
+			reinterpret_cast<const char *>(Source.data()),
+			reinterpret_cast<char *>(data.get()),
+			static_cast<int>(Source.size()),
+			static_cast<int>(UncompressedSize));
+
+		if (result < 0 || static_cast<size_t>(result) != UncompressedSize)
+			return nullptr;
+
+		return std::make_shared<const Blob>(std::move(data), UncompressedSize);
+	}
+
+	std::shared_ptr<const Blob> StripNonRuntimeParts(std::span<const uint8_t> Source)
+	{
+		auto stripped = DXContainer::StripNonRuntimeParts(Source);
+
+		if (!stripped)
+			return nullptr;
+
+		auto data = std::make_unique<uint8_t[]>(stripped->size());
+		memcpy(data.get(), stripped->data(), stripped->size());
+
+		return std::make_shared<const Blob>(std::move(data), stripped->size());
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+namespace ShaderBlob
+{
+	// Immutable shader bytecode loaded from disk. Instances are reference counted and shared between every pipeline
+	// stream copy that points into them.
+	class Blob
+	{
+	private:
+		std::span<const uint8_t> m_Data;
+		void *m_MappedView = nullptr;
+		std::unique_ptr<uint8_t[]> m_HeapData;
+		std::shared_ptr<const Blob> m_Parent;
+
+	public:
+		Blob(void *MappedView, size_t Size);
+		Blob(std::unique_ptr<uint8_t[]>&& HeapData, size_t Size);
+		Blob(std::shared_ptr<const Blob> Parent, std::span<const uint8_t> Range);
+		Blob(const Blob& Other) = delete;
+		Blob& operator=(const Blob& Other) = delete;
+		~Blob();
+
+		std::span<const uint8_t> GetData() const
+		{
+			return m_Data;
+		}
+
+		bool IsMapped() const
+		{
+			return m_MappedView != nullptr || (m_Parent && m_Parent->IsMapped());
+		}
+
+		void PrefetchPages() const;
+	};
+
+	std::shared_ptr<const Blob> LoadFile(const std::filesystem::path& Path, bool AllowMapping);
+	std::shared_ptr<const Blob> DecompressLZ4(std::span<const uint8_t> Source, size_t UncompressedSize);
+
+	// Returns a smaller copy without debug and reflection parts, or null when there's nothing to strip
+	std::shared_ptr<const Blob> StripNonRuntimeParts(std::span<const uint8_t> Source);
+}
@@ -0,0 +1,239 @@
+#include <execution>
+#include <list>
+#include "Plugin.h"
+#include "ShaderBlobCache.h"
+
+namespace ShaderBlobCache
+{
+	// Files are identified by path, size, and modification time as reported by the shader index. Contents are
+	// identified by digest. Identical files in different technique folders share one blob. Each path only keeps its
+	// latest version, so live updates don't accumulate stale entries.
+	struct FileState
+	{
+		uint64_t FileSize = 0;
+		std::filesystem::file_time_type LastWriteTime;
+		ShaderDigest::Hash Digest;
+	};
+
+	struct PathHasher
+	{
+		size_t operator()(const std::filesystem::path& Path) const
+		{
+			return std::filesystem::hash_value(Path);
+		}
+	};
+
+	std::mutex CacheLock;
+	std::list<Entry> ResidentBlobs; // Most recently used first
+	std::unordered_map<ShaderDigest::Hash, std::list<Entry>::iterator, ShaderDigest::Hasher> ContentMap;
+	std::unordered_map<std::filesystem::path, FileState, PathHasher> FileMap;
+	size_t ResidentBytes = 0;
+
+	// Bundle shaders are addressed by the digest stored in the bundle. Stripping changes the contents and therefore
+	// the digest of what's kept resident.
+	std::unordered_map<ShaderDigest::Hash, ShaderDigest::Hash, ShaderDigest::Hasher> BundleDigestMap;
+	std::atomic_size_t StrippedBytes = 0;
+
+	size_t GetMemoryLimit()
+	{
+		return static_cast<size_t>(Plugin::ShaderCacheSizeMB) * 1024 * 1024;
+	}
+
+	std::optional<Entry> FindResident(const ShaderDigest::Hash& Digest)
+	{
+		auto itr = ContentMap.find(Digest);
+
+		if (itr == ContentMap.end())
+			return std::nullopt;
+
+		ResidentBlobs.splice(ResidentBlobs.begin(), ResidentBlobs, itr->second);
+		return *itr->second;
+	}
+
+	Entry Insert(Entry&& NewEntry)
+	{
+		// Somebody else might've loaded the same contents in the meantime
+		if (auto existing = FindResident(NewEntry.Digest))
+			return *existing;
+
+		ResidentBytes += NewEntry.Blob->GetData().size();
+		ResidentBlobs.emplace_front(std::move(NewEntry));
+		ContentMap.emplace(ResidentBlobs.front().Digest, ResidentBlobs.begin());
+
+		// Evicted blobs stay alive for as long as any pipeline stream still references them. The most recent entry
+		// is never evicted.
+		while (ResidentBytes > GetMemoryLimit() && ResidentBlobs.size() > 1)
+		{
+			const auto& victim = ResidentBlobs.back();
+
+			ResidentBytes -= victim.Blob->GetData().size();
+			ContentMap.erase(victim.Digest);
+			ResidentBlobs.pop_back();
+		}
+
+		return ResidentBlobs.front();
+	}
+
+	bool StripBlob(std::shared_ptr<const ShaderBlob::Blob>& Blob)
+	{
+		if (!Plugin::StripCustomShaders)
+			return false;
+
+		auto stripped = ShaderBlob::StripNonRuntimeParts(Blob->GetData());
+
+		if (!stripped)
+			return false;
+
+		StrippedBytes += Blob->GetData().size() - stripped->GetData().size();
+		Blob = std::move(stripped);
+
+		return true;
+	}
+
+	std::optional<Entry> LoadFromBundle(const ShaderBinIndex::Entry& File)
+	{
+		const bool isCompressed = File.BundleCompression != ShaderBundleFormat::Compression::None;
+
+		{
+			std::scoped_lock lock(CacheLock);
+
+			if (auto itr = BundleDigestMap.find(File.BundleDigest); itr != BundleDigestMap.end())
+			{
+				// Uncompressed shaders with nothing to strip are used in place
+				if (!isCompressed && itr->second == File.BundleDigest)
+					return Entry { .Blob = File.BundleData, .Digest = File.BundleDigest };
+
+				if (auto resident = FindResident(itr->second))
+					return resident;
+			}
+		}
+
+		auto blob = File.BundleData;
+
+		if (isCompressed)
+		{
+			blob = ShaderBlob::DecompressLZ4(File.BundleData->GetData(), File.BundleUncompressedSize);
+
+			if (!blob)
+			{
+				spdlog::error("Failed to decompress shader from bundle: {}", File.Path.string());
+				return std::nullopt;
+			}
+		}
+
+		auto digest = File.BundleDigest;
+
+		if (StripBlob(blob))
+			digest = ShaderDigest::Compute(blob->GetData().data(), blob->GetData().size());
+
+		std::scoped_lock lock(CacheLock);
+		BundleDigestMap.insert_or_assign(File.BundleDigest, digest);
+
+		if (!isCompressed && digest == File.BundleDigest)
+			return Entry { .Blob = std::move(blob), .Digest = digest };
+
+		return Insert({ .Blob = std::move(blob), .Digest = digest });
+	}
+
+	std::optional<Entry> Load(const ShaderBinIndex::Entry& File)
+	{
+		// Uncompressed bundle shaders are already mapped and hashed. There's nothing to cache unless they have to be
+		// stripped.
+		if (File.BundleData)
+		{
+			if (File.BundleCompression == ShaderBundleFormat::Compression::None && !Plugin::StripCustomShaders)
+				return Entry { .Blob = File.BundleData, .Digest = File.BundleDigest };
+
+			return LoadFromBundle(File);
+		}
+
+		{
+			std::scoped_lock lock(CacheLock);
+
+			if (auto itr = FileMap.find(File.Path);
+				itr != FileMap.end() && itr->second.FileSize == File.FileSize && itr->second.LastWriteTime == File.LastWriteTime)
+			{
+				if (auto resident = FindResident(itr->second.Digest))
+					return resident;
+			}
+		}
+
+		// Not resident. Load and hash outside of the lock so that unrelated files don't serialize on disk I/O.
+		auto blob = ShaderBlob::LoadFile(File.Path, !Plugin::AllowLiveUpdates);
+
+		if (!blob)
+			return std::nullopt;
+
+		StripBlob(blob);
+
+		const auto data = blob->GetData();
+		const auto digest = ShaderDigest::Compute(data.data(), data.size());
+
+		std::scoped_lock lock(CacheLock);
+		FileMap.insert_or_assign(
+			File.Path,
+			FileState {
+				.FileSize = File.FileSize,
+				.LastWriteTime = File.LastWriteTime,
+				.Digest = digest,
+			});
+
+		return Insert({ .Blob = std::move(blob), .Digest = digest });
+	}
+
+	void Prefetch(std::vector<ShaderBinIndex::Entry> Files)
+	{
+		// Anything beyond the cache size would only evict earlier prefetches. Uncompressed bundle shaders don't use
+		// the cache and are always included.
+		size_t budget = GetMemoryLimit();
+
+		std::erase_if(
+			Files,
+			[&](const ShaderBinIndex::Entry& File)
+			{
+				if (File.BundleData && File.BundleCompression == ShaderBundleFormat::Compression::None)
+					return false;
+
+				if (File.FileSize > budget)
+					return true;
+
+				budget -= File.FileSize;
+				return false;
+			});
+
+		const auto start = std::chrono::steady_clock::now();
+		std::atomic_size_t totalFiles = 0;
+		std::atomic_size_t totalBytes = 0;
+
+		std::for_each(
+			std::execution::par,
+			Files.begin(),
+			Files.end(),
+			[&](const ShaderBinIndex::Entry& File)
+			{
+				auto entry = Load(File);
+
+				if (!entry)
+					return;
+
+				entry->Blob->PrefetchPages();
+
+				totalFiles++;
+				totalBytes += entry->Blob->GetData().size();
+			});
+
+		const auto end = std::chrono::steady_clock::now();
+		const auto seconds = std::chrono::duration<double>(end - start).count();
+		const auto megabytes = totalBytes / (1024.0 * 1024.0);
+
+		spdlog::info(
+			"Prefetched {} custom shader file(s), {:.1f} MB in {:.0f} ms ({:.1f} MB/s).",
+			totalFiles.load(),
+			megabytes,
+			seconds * 1000.0,
+			seconds > 0.0 ? megabytes / seconds : 0.0);
+
+		if (StrippedBytes > 0)
+			spdlog::info("Stripped {:.1f} MB of debug data from custom shaders.", StrippedBytes / (1024.0 * 1024.0));
+	}
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "ShaderBinIndex.h"
+#include "ShaderBlob.h"
+#include "ShaderDigest.h"
+
+namespace ShaderBlobCache
+{
+	struct Entry
+	{
+		std::shared_ptr<const ShaderBlob::Blob> Blob;
+		ShaderDigest::Hash Digest;
+	};
+
+	std::optional<Entry> Load(const ShaderBinIndex::Entry& File);
+	void Prefetch(std::vector<ShaderBinIndex::Entry> Files);
+}
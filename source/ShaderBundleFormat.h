@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <string_view>
+#include <vector>
+#include "ShaderDigest.h"
+
+//
+// Shader bundles pack an entire shadersfx tree into a single file:
+//
+// [Header]
+// [Entry * EntryCount]  Sorted by technique name, technique id, and stage
+// [Name table]          Lowercase technique short names, not null terminated
+// [Blobs]               Each blob starts on a BlobAlignment boundary and is optionally compressed
+//
+// All offsets are relative to the start of the file. Everything is little endian. This header has no platform
+// dependencies and is shared with the command line tools.
+//
+namespace ShaderBundleFormat
+{
+	constexpr uint32_t Magic = 0x42495353; // "SSIB"
+	constexpr uint32_t CurrentVersion = 2;
+	constexpr uint64_t BlobAlignment = 64;
+	constexpr std::string_view FileExtension = ".shaderbundle";
+
+	// Matches the file name suffixes used by loose .bin files
+	enum class Stage : uint8_t
+	{
+		RootSignature = 0,
+		Vertex = 1,
+		Pixel = 2,
+		Domain = 3,
+		Hull = 4,
+		Geometry = 5,
+		Compute = 6,
+		Amplification = 7,
+		Mesh = 8,
+		Count,
+	};
+
+	enum class Compression : uint8_t
+	{
+		None = 0,
+		LZ4 = 1, // LZ4 block format, no frame header
+	};
+
+	constexpr std::string_view StagePrefixes[] = { "rsg", "vs", "ps", "ds", "hs", "gs", "cs", "as", "ms" };
+	static_assert(std::size(StagePrefixes) == static_cast<size_t>(Stage::Count));
+
+	struct Header
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t EntryCount;
+		uint32_t Reserved;
+		uint64_t EntriesOffset;
+		uint64_t NamesOffset;
+		uint64_t NamesSize;
+	};
+	static_assert(sizeof(Header) == 40);
+
+	struct Entry
+	{
+		uint64_t TechniqueId;
+		uint32_t NameOffset; // Relative to Header::NamesOffset
+		uint16_t NameLength;
+		Stage ShaderStage;
+		Compression BlobCompression;
+		uint64_t DataOffset;
+		uint64_t DataSize; // Size stored in the file
+		uint64_t UncompressedSize;
+		ShaderDigest::Hash Digest; // ShaderDigest::Compute() over the uncompressed blob
+	};
+	static_assert(sizeof(Entry) == 56);
+
+	// An entry that passed validation along with the technique name and stored data it refers to
+	struct ParsedEntry
+	{
+		const Entry *Info = nullptr;
+		std::string_view TechniqueShortName;
+		std::span<const uint8_t> Data;
+	};
+
+	// Validates a bundle held in memory. Returns false when the header or tables don't fit in Data. Entries with an
+	// unknown stage or compression, or that point outside of the file, are left out and counted in SkippedEntries.
+	inline bool Parse(std::span<const uint8_t> Data, std::vector<ParsedEntry>& Entries, size_t& SkippedEntries)
+	{
+		auto inBounds = [&](uint64_t Offset, uint64_t Size)
+		{
+			return Offset <= Data.size() && Size <= Data.size() - Offset;
+		};
+
+		if (!inBounds(0, sizeof(Header)))
+			return false;
+
+		const auto header = reinterpret_cast<const Header *>(Data.data());
+
+		if (header->Magic != Magic || header->Version != CurrentVersion ||
+			!inBounds(header->EntriesOffset, static_cast<uint64_t>(header->EntryCount) * sizeof(Entry)) ||
+			!inBounds(header->NamesOffset, header->NamesSize))
+			return false;
+
+		const std::span entries(reinterpret_cast<const Entry *>(Data.data() + header->EntriesOffset), header->EntryCount);
+		const std::string_view names(reinterpret_cast<const char *>(Data.data() + header->NamesOffset), header->NamesSize);
+
+		Entries.clear();
+		Entries.reserve(entries.size());
+		SkippedEntries = 0;
+
+		for (const auto& entry : entries)
+		{
+			const bool validCompression = (entry.BlobCompression == Compression::None && entry.UncompressedSize == entry.DataSize) ||
+										  (entry.BlobCompression == Compression::LZ4 && entry.UncompressedSize != 0);
+
+			if (entry.ShaderStage >= Stage::Count || !validCompression ||
+				static_cast<uint64_t>(entry.NameOffset) + entry.NameLength > names.size() || !inBounds(entry.DataOffset, entry.DataSize) ||
+				entry.DataSize == 0)
+			{
+				SkippedEntries++;
+				continue;
+			}
+
+			Entries.emplace_back(ParsedEntry {
+				.Info = &entry,
+				.TechniqueShortName = names.substr(entry.NameOffset, entry.NameLength),
+				.Data = Data.subspan(entry.DataOffset, entry.DataSize),
+			});
+		}
+
+		return true;
+	}
+}
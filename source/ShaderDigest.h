@@ -0,0 +1,101 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <xxhash.h>
+
+namespace ShaderDigest
+{
+	// 128-bit content hash used to identify shader blobs regardless of where they came from. This header has no
+	// platform dependencies and is shared with the command line tools.
+	struct Hash
+	{
+		uint64_t Low = 0;
+		uint64_t High = 0;
+
+		bool operator==(const Hash& Other) const = default;
+
+		bool IsZero() const
+		{
+			return Low == 0 && High == 0;
+		}
+
+		std::string ToString() const
+		{
+			char buffer[33];
+			snprintf(buffer, sizeof(buffer), "%016llX%016llX", static_cast<unsigned long long>(High), static_cast<unsigned long long>(Low));
+
+			return buffer;
+		}
+
+		static std::optional<Hash> FromString(std::string_view Text)
+		{
+			// Inverse of ToString()
+			Hash hash;
+
+			if (Text.size() != 32 ||
+				std::from_chars(Text.data(), Text.data() + 16, hash.High, 16).ptr != Text.data() + 16 ||
+				std::from_chars(Text.data() + 16, Text.data() + 32, hash.Low, 16).ptr != Text.data() + 32)
+				return std::nullopt;
+
+			return hash;
+		}
+	};
+
+	struct Hasher
+	{
+		size_t operator()(const Hash& Value) const
+		{
+			return static_cast<size_t>(Value.Low ^ (Value.High * 0x9E3779B97F4A7C15ull));
+		}
+	};
+
+	inline Hash Compute(const void *Data, size_t Size)
+	{
+		const auto value = XXH3_128bits(Data, Size);
+		return { value.low64, value.high64 };
+	}
+
+	// Incremental version of Compute() for data that isn't contiguous
+	class Builder
+	{
+	private:
+		struct StateDeleter
+		{
+			void operator()(XXH3_state_t *State) const
+			{
+				XXH3_freeState(State);
+			}
+		};
+
+		std::unique_ptr<XXH3_state_t, StateDeleter> m_State { XXH3_createState() };
+
+	public:
+		Builder()
+		{
+			XXH3_128bits_reset(m_State.get());
+		}
+
+		void Add(const void *Data, size_t Size)
+		{
+			XXH3_128bits_update(m_State.get(), Data, Size);
+		}
+
+		template<typename T>
+		void AddValue(const T& Value)
+		{
+			Add(&Value, sizeof(T));
+		}
+
+		Hash Finish() const
+		{
+			const auto value = XXH3_128bits_digest(m_State.get());
+			return { value.low64, value.high64 };
+		}
+	};
+}
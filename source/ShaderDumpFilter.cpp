@@ -0,0 +1,257 @@
+#include <charconv>
+#include <unordered_set>
+#include "D3DShaderReplacement.h"
+#include "ShaderDumpFilter.h"
+
+namespace ShaderDumpFilter
+{
+	// Patterns without wildcards go into a hash set. Everything else is matched one by one. All patterns are lowercase.
+	struct NamePatterns
+	{
+		std::unordered_set<std::string> ExactNames;
+		std::vector<std::string> Globs;
+
+		bool IsEmpty() const
+		{
+			return ExactNames.empty() && Globs.empty();
+		}
+	};
+
+	bool Enabled = false;
+	NamePatterns IncludedNames;
+	NamePatterns ExcludedNames;
+	std::vector<std::pair<uint64_t, uint64_t>> IdRanges; // Inclusive
+	uint32_t StageMask = 0; // One bit per D3D12_PIPELINE_STATE_SUBOBJECT_TYPE
+
+	char ToLowerAscii(char C)
+	{
+		return (C >= 'A' && C <= 'Z') ? static_cast<char>(C - 'A' + 'a') : C;
+	}
+
+	template<typename T>
+	void ForEachToken(std::string_view List, T&& Callback)
+	{
+		// Comma separated, surrounding whitespace ignored
+		while (!List.empty())
+		{
+			const auto separator = std::min(List.find(','), List.size());
+			auto token = List.substr(0, separator);
+
+			List.remove_prefix(std::min(separator + 1, List.size()));
+
+			while (!token.empty() && (token.front() == ' ' || token.front() == '\t'))
+				token.remove_prefix(1);
+
+			while (!token.empty() && (token.back() == ' ' || token.back() == '\t'))
+				token.remove_suffix(1);
+
+			if (!token.empty())
+				Callback(token);
+		}
+	}
+
+	bool GlobMatches(std::string_view Pattern, std::string_view Name)
+	{
+		// '*' matches any sequence and '?' matches a single character. Only the most recent '*' needs to be revisited
+		// on a mismatch.
+		size_t p = 0;
+		size_t n = 0;
+		size_t starPattern = std::string_view::npos;
+		size_t starName = 0;
+
+		while (n < Name.size())
+		{
+			if (p < Pattern.size() && (Pattern[p] == '?' || Pattern[p] == ToLowerAscii(Name[n])))
+			{
+				p++;
+				n++;
+			}
+			else if (p < Pattern.size() && Pattern[p] == '*')
+			{
+				starPattern = p++;
+				starName = n;
+			}
+			else if (starPattern != std::string_view::npos)
+			{
+				p = starPattern + 1;
+				n = ++starName;
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		while (p < Pattern.size() && Pattern[p] == '*')
+			p++;
+
+		return p == Pattern.size();
+	}
+
+	bool NameMatches(const NamePatterns& Patterns, std::string_view Name)
+	{
+		char lowercaseName[512];
+
+		if (Name.size() >= std::size(lowercaseName))
+			return false;
+
+		std::transform(Name.begin(), Name.end(), lowercaseName, ToLowerAscii);
+
+		if (Patterns.ExactNames.contains(std::string(lowercaseName, Name.size())))
+			return true;
+
+		return std::any_of(
+			Patterns.Globs.begin(),
+			Patterns.Globs.end(),
+			[&](const std::string& Glob)
+			{
+				return GlobMatches(Glob, Name);
+			});
+	}
+
+	bool IdMatches(uint64_t TechniqueId)
+	{
+		return std::any_of(
+			IdRanges.begin(),
+			IdRanges.end(),
+			[&](const auto& Range)
+			{
+				return TechniqueId >= Range.first && TechniqueId <= Range.second;
+			});
+	}
+
+	NamePatterns ParseNamePatterns(std::string_view List)
+	{
+		NamePatterns patterns;
+
+		ForEachToken(
+			List,
+			[&](std::string_view Token)
+			{
+				std::string pattern(Token);
+				std::transform(pattern.begin(), pattern.end(), pattern.begin(), ToLowerAscii);
+
+				if (pattern.find_first_of("*?") == std::string::npos)
+					patterns.ExactNames.emplace(std::move(pattern));
+				else
+					patterns.Globs.emplace_back(std::move(pattern));
+			});
+
+		return patterns;
+	}
+
+	std::optional<uint64_t> ParseHexId(std::string_view Text)
+	{
+		if (Text.starts_with("0x") || Text.starts_with("0X"))
+			Text.remove_prefix(2);
+
+		uint64_t value = 0;
+		const auto result = std::from_chars(Text.data(), Text.data() + Text.size(), value, 16);
+
+		if (Text.empty() || result.ec != std::errc() || result.ptr != Text.data() + Text.size())
+			return std::nullopt;
+
+		return value;
+	}
+
+	std::optional<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE> ParseStage(std::string_view Prefix)
+	{
+		char lowercasePrefix[16];
+
+		if (Prefix.size() >= std::size(lowercasePrefix))
+			return std::nullopt;
+
+		std::transform(Prefix.begin(), Prefix.end(), lowercasePrefix, ToLowerAscii);
+		const std::string_view prefix(lowercasePrefix, Prefix.size());
+
+		for (const auto type : {
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_HS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_GS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_AS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_MS,
+				 D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE,
+			 })
+		{
+			if (prefix == D3DShaderReplacement::GetShaderTypePrefix(type))
+				return type;
+		}
+
+		return std::nullopt;
+	}
+
+	void Initialize(std::string_view IncludeTechniques, std::string_view ExcludeTechniques, std::string_view TechniqueIds, std::string_view Stages)
+	{
+		IncludedNames = ParseNamePatterns(IncludeTechniques);
+		ExcludedNames = ParseNamePatterns(ExcludeTechniques);
+
+		// "FF81" or "100-1FF"
+		ForEachToken(
+			TechniqueIds,
+			[&](std::string_view Token)
+			{
+				const auto separator = Token.find('-');
+				const auto low = ParseHexId(Token.substr(0, separator));
+				const auto high = (separator == std::string_view::npos) ? low : ParseHexId(Token.substr(separator + 1));
+
+				if (!low || !high || *low > *high)
+					spdlog::warn("Ignoring invalid shader dump technique id range: {}", Token);
+				else
+					IdRanges.emplace_back(*low, *high);
+			});
+
+		// Same prefixes as .bin file names, i.e. "ps" or "cs"
+		ForEachToken(
+			Stages,
+			[&](std::string_view Token)
+			{
+				if (const auto type = ParseStage(Token))
+					StageMask |= 1u << *type;
+				else
+					spdlog::warn("Ignoring invalid shader dump stage: {}", Token);
+			});
+
+		Enabled = !IncludedNames.IsEmpty() || !ExcludedNames.IsEmpty() || !IdRanges.empty() || StageMask != 0;
+
+		if (Enabled)
+		{
+			spdlog::info(
+				"Shader dump filter: {} included technique pattern(s), {} excluded, {} id range(s), stage mask {:X}.",
+				IncludedNames.ExactNames.size() + IncludedNames.Globs.size(),
+				ExcludedNames.ExactNames.size() + ExcludedNames.Globs.size(),
+				IdRanges.size(),
+				StageMask);
+		}
+	}
+
+	bool Matches(std::string_view TechniqueShortName, uint64_t TechniqueId, D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type)
+	{
+		if (!Enabled)
+			return true;
+
+		// Cheapest checks first
+		if (StageMask != 0 && (static_cast<uint32_t>(Type) >= 32 || (StageMask & (1u << Type)) == 0))
+			return false;
+
+		if (!IdRanges.empty() && !IdMatches(TechniqueId))
+			return false;
+
+		if (!IncludedNames.IsEmpty() && !NameMatches(IncludedNames, TechniqueShortName))
+			return false;
+
+		if (!ExcludedNames.IsEmpty() && NameMatches(ExcludedNames, TechniqueShortName))
+			return false;
+
+		return true;
+	}
+
+	bool Matches(std::string_view TechniqueShortName, uint64_t TechniqueId, std::string_view TypePrefix)
+	{
+		// Unknown stages never match a stage filter
+		const auto type = ParseStage(TypePrefix).value_or(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_MAX_VALID);
+		return Matches(TechniqueShortName, TechniqueId, type);
+	}
+}
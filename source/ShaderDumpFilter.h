@@ -0,0 +1,8 @@
+#pragma once
+
+namespace ShaderDumpFilter
+{
+	void Initialize(std::string_view IncludeTechniques, std::string_view ExcludeTechniques, std::string_view TechniqueIds, std::string_view Stages);
+	bool Matches(std::string_view TechniqueShortName, uint64_t TechniqueId, D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type);
+	bool Matches(std::string_view TechniqueShortName, uint64_t TechniqueId, std::string_view TypePrefix);
+}
@@ -0,0 +1,502 @@
+#include <charconv>
+#include <condition_variable>
+#include <unordered_set>
+#include "DebuggingUtil.h"
+#include "Plugin.h"
+#include "ShaderDigest.h"
+#include "ShaderDumpFilter.h"
+#include "ShaderDumpWriter.h"
+
+namespace ShaderDumpWriter
+{
+	struct PendingShader
+	{
+		std::string TechniqueShortName;
+		std::string TechniqueName;
+		uint64_t TechniqueId = 0;
+		const char *TypePrefix = nullptr;
+		std::vector<uint8_t> Bytecode;
+	};
+
+	// Game threads only pay for a copy of the bytecode. They're blocked once this much data is waiting to be written
+	// so that a slow disk can't grow the queue without bounds.
+	constexpr size_t MaxPendingBytes = 64 * 1024 * 1024;
+
+	std::mutex QueueLock;
+	std::condition_variable QueueNotEmpty;
+	std::condition_variable QueueNotFull;
+	std::vector<PendingShader> Queue;
+	size_t PendingBytes = 0; // Queued plus currently being written
+	bool StopRequested = false;
+	std::jthread WriterThreadHandle; // Joined on destruction in case Shutdown() never ran
+	std::filesystem::path DumpRootDirectory;
+
+	// Every unique shader is stored once as "<Root>/blobs/<Digest>.bin". ShaderManifest.csv maps techniques to blobs.
+	constexpr auto BlobDirectoryName = "blobs";
+	constexpr auto ManifestFileName = "ShaderManifest.csv";
+	constexpr auto RemovedListFileName = "ShaderManifestRemoved.csv";
+
+	// The writer thread takes this long without new shaders as a sign that loading has finished
+	constexpr auto IdleTimeout = std::chrono::seconds(5);
+
+	// Size and last write time of a dumped file. Files are only read back and hashed when either of them changed.
+	struct FileStamp
+	{
+		uint64_t Size = 0;
+		int64_t LastWriteTime = 0;
+
+		bool operator==(const FileStamp& Other) const = default;
+	};
+
+	struct ManifestEntry
+	{
+		ShaderDigest::Hash Digest;
+		FileStamp Stamp;
+		std::string Line;
+	};
+
+	struct WriterState
+	{
+		std::unordered_set<std::filesystem::path> CreatedDirectories;
+		std::unordered_set<ShaderDigest::Hash, ShaderDigest::Hasher> StoredBlobs;
+		std::ofstream CsvFile;
+		std::ofstream ManifestFile;
+		std::vector<uint8_t> ReadBuffer;
+		bool HardlinksSupported = Plugin::ShaderDumpHardlinks;
+
+		// Keyed by "<Technique>,<Stage>,<Id>", i.e. the first three manifest columns
+		std::unordered_map<std::string, ManifestEntry> Manifest;
+		std::unordered_set<std::string> PreviousKeys;
+		std::unordered_set<std::string> SeenKeys;
+		bool IdleReportPending = false;
+
+		size_t WrittenCount = 0;
+		size_t UnchangedCount = 0;
+	};
+
+	std::optional<FileStamp> GetFileStamp(const std::filesystem::path& Path)
+	{
+		std::error_code ec;
+		const auto size = std::filesystem::file_size(Path, ec);
+
+		if (ec)
+			return std::nullopt;
+
+		const auto lastWriteTime = std::filesystem::last_write_time(Path, ec);
+
+		if (ec)
+			return std::nullopt;
+
+		return FileStamp {
+			.Size = size,
+			.LastWriteTime = lastWriteTime.time_since_epoch().count(),
+		};
+	}
+
+	void LoadPreviousManifest(WriterState& State)
+	{
+		// The manifest is append only while dumping so later lines win. It's rewritten without duplicates once here.
+		// Lines are "<Technique>,<Stage>,<Id>,<Digest>,<Size>,<LastWriteTime>,\"<Full technique name>\"". Lines
+		// without a valid stamp are hashed once to get one.
+		const auto manifestPath = DumpRootDirectory / ManifestFileName;
+		std::ifstream f(manifestPath);
+		std::string line;
+
+		while (std::getline(f, line))
+		{
+			const auto first = line.find(',');
+			const auto second = line.find(',', first + 1);
+			const auto separator = line.find(',', second + 1);
+
+			if (first == std::string::npos || second == std::string::npos || separator == std::string::npos)
+				continue;
+
+			auto digest = ShaderDigest::Hash::FromString(std::string_view(line).substr(separator + 1, 32));
+
+			if (!digest)
+				continue;
+
+			FileStamp stamp;
+			const std::string_view stampText = std::string_view(line).substr(std::min(line.size(), separator + 34));
+
+			if (const auto sizeEnd = stampText.find(','); sizeEnd != std::string_view::npos)
+			{
+				const auto timeText = stampText.substr(sizeEnd + 1, stampText.find(',', sizeEnd + 1) - sizeEnd - 1);
+
+				if (std::from_chars(stampText.data(), stampText.data() + sizeEnd, stamp.Size).ec != std::errc() ||
+					std::from_chars(timeText.data(), timeText.data() + timeText.size(), stamp.LastWriteTime).ec != std::errc())
+					stamp = {};
+			}
+
+			auto key = line.substr(0, separator);
+			State.PreviousKeys.emplace(key);
+			State.Manifest.insert_or_assign(
+				std::move(key),
+				ManifestEntry {
+					.Digest = *digest,
+					.Stamp = stamp,
+					.Line = std::move(line),
+				});
+		}
+
+		f.close();
+
+		if (State.Manifest.empty())
+			return;
+
+		auto tempPath = manifestPath;
+		tempPath += ".tmp";
+
+		if (std::ofstream out(tempPath, std::ios::trunc); out.good())
+		{
+			for (const auto& [key, entry] : State.Manifest)
+				out << entry.Line << '\n';
+		}
+
+		std::error_code ec;
+		std::filesystem::rename(tempPath, manifestPath, ec);
+
+		State.IdleReportPending = true;
+		spdlog::info("Loaded {} entries from the previous shader dump manifest.", State.Manifest.size());
+	}
+
+	bool IsFilteredOut(std::string_view Key)
+	{
+		// "<Technique>,<Stage>,<Id>"
+		const auto first = Key.find(',');
+		const auto second = Key.find(',', first + 1);
+
+		if (first == std::string_view::npos || second == std::string_view::npos)
+			return false;
+
+		const auto idText = Key.substr(second + 1);
+		uint64_t id = 0;
+
+		if (std::from_chars(idText.data(), idText.data() + idText.size(), id, 16).ec != std::errc())
+			return false;
+
+		return !ShaderDumpFilter::Matches(Key.substr(0, first), id, Key.substr(first + 1, second - first - 1));
+	}
+
+	void WriteRemovedList(WriterState& State)
+	{
+		// Entries from the previous dump that haven't been seen during this run. The game doesn't necessarily create
+		// every pipeline each session, so this is only a hint and the manifest keeps them. Shaders excluded by the dump
+		// filter were never going to be seen.
+		size_t removedCount = 0;
+
+		if (std::ofstream f(DumpRootDirectory / RemovedListFileName, std::ios::trunc); f.good())
+		{
+			for (const auto& key : State.PreviousKeys)
+			{
+				if (State.SeenKeys.contains(key) || IsFilteredOut(key))
+					continue;
+
+				f << State.Manifest.at(key).Line << '\n';
+				removedCount++;
+			}
+		}
+
+		State.IdleReportPending = false;
+
+		spdlog::info(
+			"Shader dump idle: {} written, {} unchanged, {} previous entries not seen.",
+			State.WrittenCount,
+			State.UnchangedCount,
+			removedCount);
+	}
+
+	bool FileMatches(WriterState& State, const std::filesystem::path& Path, const ShaderDigest::Hash& Digest, size_t Size)
+	{
+		// Dumped files can be edited in place after the fact. Sizes rule out most edits without reading anything.
+		std::error_code ec;
+
+		if (std::filesystem::file_size(Path, ec) != Size || ec)
+			return false;
+
+		std::ifstream f(Path, std::ios::binary);
+		State.ReadBuffer.resize(Size);
+
+		if (!f.read(reinterpret_cast<char *>(State.ReadBuffer.data()), Size))
+			return false;
+
+		return ShaderDigest::Compute(State.ReadBuffer.data(), Size) == Digest;
+	}
+
+	void AppendManifestEntry(
+		WriterState& State,
+		const char *Key,
+		const ShaderDigest::Hash& Digest,
+		const FileStamp& Stamp,
+		const std::string& TechniqueName)
+	{
+		char line[2048];
+		const auto length = sprintf_s(
+			line,
+			"%s,%s,%llu,%lld,\"%s\"",
+			Key,
+			Digest.ToString().c_str(),
+			Stamp.Size,
+			Stamp.LastWriteTime,
+			TechniqueName.c_str());
+
+		if (State.ManifestFile.good())
+			State.ManifestFile << line << '\n';
+
+		State.Manifest.insert_or_assign(
+			Key,
+			ManifestEntry {
+				.Digest = Digest,
+				.Stamp = Stamp,
+				.Line = std::string(line, length),
+			});
+	}
+
+	bool StoreBlob(WriterState& State, const ShaderDigest::Hash& Digest, const std::filesystem::path& BlobPath, std::span<const uint8_t> Data)
+	{
+		if (State.StoredBlobs.contains(Digest))
+			return true;
+
+		// Blobs are content addressed, but a blob left over from a previous run might've been edited through a
+		// hardlink. It's only reused when it still matches.
+		if (!FileMatches(State, BlobPath, Digest, Data.size()))
+		{
+			std::ofstream f(BlobPath, std::ios::binary | std::ios::trunc);
+
+			if (!f.good() || !f.write(reinterpret_cast<const char *>(Data.data()), Data.size()))
+			{
+				spdlog::error("Failed to write shader blob: {}", BlobPath.string());
+				return false;
+			}
+		}
+
+		State.StoredBlobs.emplace(Digest);
+		return true;
+	}
+
+	void MaterializeFile(WriterState& State, const std::filesystem::path& BlobPath, const std::filesystem::path& TargetPath)
+	{
+		std::error_code ec;
+
+		if (State.CreatedDirectories.emplace(TargetPath.parent_path()).second)
+			std::filesystem::create_directories(TargetPath.parent_path(), ec);
+
+		std::filesystem::remove(TargetPath, ec);
+
+		// Hardlinks keep a single copy of each shader on disk. Some file systems (FAT32, exFAT, network shares) don't do
+		// hardlinks and get copies instead, as do users who asked for them.
+		if (State.HardlinksSupported)
+		{
+			std::filesystem::create_hard_link(BlobPath, TargetPath, ec);
+
+			if (!ec)
+				return;
+
+			spdlog::warn("Failed to create hardlinks in the dump folder ({}). Copying files instead.", ec.message());
+			State.HardlinksSupported = false;
+		}
+
+		std::filesystem::copy_file(BlobPath, TargetPath, std::filesystem::copy_options::overwrite_existing, ec);
+	}
+
+	void WriteBatch(WriterState& State, const std::vector<PendingShader>& Batch)
+	{
+		for (const auto& shader : Batch)
+		{
+			const auto digest = ShaderDigest::Compute(shader.Bytecode.data(), shader.Bytecode.size());
+			const auto blobPath = DumpRootDirectory / BlobDirectoryName / (digest.ToString() + ".bin");
+
+			char shaderBinFileName[512];
+			sprintf_s(shaderBinFileName, "%s_%llX_%s.bin", shader.TechniqueShortName.c_str(), shader.TechniqueId, shader.TypePrefix);
+
+			const auto shaderBinFullPath = DumpRootDirectory / shader.TechniqueShortName / shaderBinFileName;
+
+			char key[1024];
+			sprintf_s(key, "%s,%s,%llX", shader.TechniqueShortName.c_str(), shader.TypePrefix, shader.TechniqueId);
+
+			if (State.SeenKeys.emplace(key).second && State.PreviousKeys.contains(key))
+				State.IdleReportPending = true;
+
+			// Nothing to do when the previous dump already has identical contents and the file on disk still matches
+			// them. Files that were deleted or edited in place are restored. A file is only read back when its stamp
+			// differs from the one recorded, and the new stamp is recorded if the contents turn out to be unchanged.
+			const auto previous = State.Manifest.find(key);
+			const auto& dumpedPath = Plugin::ShaderDumpLooseFiles ? shaderBinFullPath : blobPath;
+
+			if (previous != State.Manifest.end() && previous->second.Digest == digest)
+			{
+				const auto stamp = GetFileStamp(dumpedPath);
+
+				if (stamp && *stamp == previous->second.Stamp)
+				{
+					State.UnchangedCount++;
+					continue;
+				}
+
+				if (stamp && FileMatches(State, dumpedPath, digest, shader.Bytecode.size()))
+				{
+					AppendManifestEntry(State, key, digest, *stamp, shader.TechniqueName);
+					State.UnchangedCount++;
+					continue;
+				}
+			}
+
+			if (!StoreBlob(State, digest, blobPath, shader.Bytecode))
+				continue;
+
+			if (Plugin::ShaderDumpLooseFiles)
+				MaterializeFile(State, blobPath, shaderBinFullPath);
+
+			// Then map it to a technique name in the manifest and the legacy CSV file
+			const auto hash = DebuggingUtil::FNV1A32(shader.Bytecode.data(), shader.Bytecode.size());
+			spdlog::info("Dumping shader with hash {} to {}", hash, blobPath.string());
+
+			AppendManifestEntry(State, key, digest, GetFileStamp(dumpedPath).value_or(FileStamp {}), shader.TechniqueName);
+			State.WrittenCount++;
+			State.IdleReportPending = true;
+
+			if (State.CsvFile.good())
+			{
+				char csvLine[2048];
+				const auto length = sprintf_s(
+					csvLine,
+					"%s,%s,%u,%llX,\"%s\"\n",
+					shader.TechniqueShortName.c_str(),
+					shader.TypePrefix,
+					hash,
+					shader.TechniqueId,
+					shader.TechniqueName.c_str());
+
+				State.CsvFile.write(csvLine, length);
+			}
+		}
+
+		State.ManifestFile.flush();
+		State.CsvFile.flush();
+	}
+
+	void WriterThread()
+	{
+		WriterState state;
+		std::vector<PendingShader> batch;
+
+		std::filesystem::create_directories(DumpRootDirectory / BlobDirectoryName);
+		LoadPreviousManifest(state);
+
+		state.CsvFile.open(DumpRootDirectory / "ShaderTechniqueMap.csv", std::ios::app);
+		state.ManifestFile.open(DumpRootDirectory / ManifestFileName, std::ios::app);
+
+		if (!state.CsvFile.good() || !state.ManifestFile.good())
+			spdlog::error("Failed to open shader dump manifests for writing. Shaders will still be dumped.");
+
+		while (true)
+		{
+			// Everything queued up while the previous batch was being written is taken at once
+			{
+				std::unique_lock lock(QueueLock);
+				const bool hasWork = QueueNotEmpty.wait_for(
+					lock,
+					IdleTimeout,
+					[]
+					{
+						return !Queue.empty() || StopRequested;
+					});
+
+				// Everything queued before the stop request has been written at this point
+				if (Queue.empty() && StopRequested)
+					break;
+
+				if (!hasWork)
+				{
+					lock.unlock();
+
+					if (state.IdleReportPending)
+						WriteRemovedList(state);
+
+					continue;
+				}
+
+				batch.swap(Queue);
+			}
+
+			size_t batchBytes = 0;
+
+			for (const auto& shader : batch)
+				batchBytes += shader.Bytecode.size();
+
+			WriteBatch(state, batch);
+			batch.clear();
+
+			{
+				std::scoped_lock lock(QueueLock);
+				PendingBytes -= batchBytes;
+			}
+
+			QueueNotFull.notify_all();
+		}
+
+		if (state.IdleReportPending)
+			WriteRemovedList(state);
+
+		spdlog::info("Shader dump finished: {} written, {} unchanged.", state.WrittenCount, state.UnchangedCount);
+	}
+
+	void Initialize(const std::filesystem::path& RootDirectory)
+	{
+		DumpRootDirectory = RootDirectory;
+		WriterThreadHandle = std::jthread(WriterThread);
+	}
+
+	void Shutdown()
+	{
+		{
+			std::scoped_lock lock(QueueLock);
+
+			if (StopRequested || !WriterThreadHandle.joinable())
+				return;
+
+			StopRequested = true;
+		}
+
+		QueueNotEmpty.notify_one();
+		QueueNotFull.notify_all();
+
+		WriterThreadHandle.join();
+	}
+
+	void Enqueue(
+		const char *TechniqueShortName,
+		const char *TechniqueName,
+		uint64_t TechniqueId,
+		const char *TypePrefix,
+		std::span<const uint8_t> Bytecode)
+	{
+		PendingShader shader {
+			.TechniqueShortName = TechniqueShortName,
+			.TechniqueName = TechniqueName,
+			.TechniqueId = TechniqueId,
+			.TypePrefix = TypePrefix,
+			.Bytecode = { Bytecode.begin(), Bytecode.end() },
+		};
+
+		{
+			// Oversized shaders are let through when nothing else is pending. They'd never fit otherwise.
+			std::unique_lock lock(QueueLock);
+			QueueNotFull.wait(
+				lock,
+				[&]
+				{
+					return PendingBytes == 0 || PendingBytes + Bytecode.size() <= MaxPendingBytes || StopRequested;
+				});
+
+			// The game is exiting and nothing is written anymore
+			if (StopRequested)
+				return;
+
+			PendingBytes += Bytecode.size();
+			Queue.emplace_back(std::move(shader));
+		}
+
+		QueueNotEmpty.notify_one();
+	}
+}
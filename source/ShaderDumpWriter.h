@@ -0,0 +1,13 @@
+#pragma once
+
+namespace ShaderDumpWriter
+{
+	void Initialize(const std::filesystem::path& RootDirectory);
+	void Shutdown();
+	void Enqueue(
+		const char *TechniqueShortName,
+		const char *TechniqueName,
+		uint64_t TechniqueId,
+		const char *TypePrefix,
+		std::span<const uint8_t> Bytecode);
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "DXContainer.h"
+#include "ShaderBundleFormat.h"
+#include "ShaderDigest.h"
+
+//
+// Naming rules for custom shader files below one of the shader root directories:
+//
+// <Technique>/<Technique>_<Id>_<Stage>.bin   Replaces one stage of a technique
+// ByHash/<Digest>.bin                         Replaces a shader by its original DXBC container digest
+// *.shaderbundle                              Bundles in the root directory
+//
+// Names are compared in lowercase since Windows file names are case insensitive. This header has no platform
+// dependencies and is shared with the tests.
+//
+namespace ShaderPaths
+{
+	constexpr std::string_view ContainerDigestDirectoryName = "byhash";
+
+	struct ShaderFileName
+	{
+		std::string TechniqueShortName; // Lowercase
+		uint64_t TechniqueId = 0;
+		ShaderBundleFormat::Stage Stage = {};
+	};
+
+	// What a file below one of the root directories replaces, derived from its relative path alone. Lets live updates
+	// map file system changes back to the pipelines using them.
+	struct PathTarget
+	{
+		enum class Kind
+		{
+			Ignored,		 // Not a custom shader file
+			Technique,		 // "<Technique>/<Technique>_<Id>_<Stage>.bin"
+			ContainerDigest, // "ByHash/<Digest>.bin"
+			Everything,		 // Bundles and top level folders can affect any technique
+		};
+
+		Kind Type = Kind::Ignored;
+		std::string TechniqueShortName; // Lowercase
+		uint64_t TechniqueId = 0;
+		ShaderDigest::Hash ContainerDigest;
+
+		bool operator==(const PathTarget& Other) const = default;
+	};
+
+	template<typename T>
+	std::optional<std::string> ToLowerAscii(std::basic_string_view<T> Input)
+	{
+		std::string output;
+		output.reserve(Input.size());
+
+		for (const auto c : Input)
+		{
+			if (c <= 0 || c >= 0x80)
+				return std::nullopt;
+
+			output.push_back(static_cast<char>((c >= 'A' && c <= 'Z') ? (c - 'A' + 'a') : c));
+		}
+
+		return output;
+	}
+
+	inline std::optional<ShaderBundleFormat::Stage> ParseStage(std::string_view Prefix)
+	{
+		const auto itr = std::find(std::begin(ShaderBundleFormat::StagePrefixes), std::end(ShaderBundleFormat::StagePrefixes), Prefix);
+
+		if (itr == std::end(ShaderBundleFormat::StagePrefixes))
+			return std::nullopt;
+
+		return static_cast<ShaderBundleFormat::Stage>(std::distance(std::begin(ShaderBundleFormat::StagePrefixes), itr));
+	}
+
+	inline bool ParseShaderBinFileName(std::string_view FileName, std::string_view DirectoryName, ShaderFileName& Out)
+	{
+		// Expected format is "<Technique>_<Id>_<Stage>.bin" where the technique is the folder name. Everything
+		// is lowercase at this point.
+		constexpr std::string_view extension = ".bin";
+
+		if (!FileName.ends_with(extension))
+			return false;
+
+		FileName.remove_suffix(extension.size());
+
+		const auto stageSeparator = FileName.rfind('_');
+
+		if (stageSeparator == std::string_view::npos || stageSeparator == 0)
+			return false;
+
+		const auto idSeparator = FileName.rfind('_', stageSeparator - 1);
+
+		if (idSeparator == std::string_view::npos)
+			return false;
+
+		const auto techniqueShortName = FileName.substr(0, idSeparator);
+		const auto techniqueId = FileName.substr(idSeparator + 1, stageSeparator - idSeparator - 1);
+		const auto stage = ParseStage(FileName.substr(stageSeparator + 1));
+
+		if (techniqueShortName != DirectoryName || !stage)
+			return false;
+
+		const auto result = std::from_chars(techniqueId.data(), techniqueId.data() + techniqueId.size(), Out.TechniqueId, 16);
+
+		if (result.ec != std::errc() || result.ptr != techniqueId.data() + techniqueId.size())
+			return false;
+
+		Out.TechniqueShortName = techniqueShortName;
+		Out.Stage = *stage;
+
+		return true;
+	}
+
+	inline PathTarget ClassifyPath(const std::filesystem::path& RelativePath)
+	{
+		std::vector<std::string> components;
+
+		for (const auto& component : RelativePath)
+		{
+			auto name = ToLowerAscii<std::filesystem::path::value_type>(component.native());
+
+			if (!name)
+				return {};
+
+			components.emplace_back(std::move(*name));
+		}
+
+		PathTarget target;
+
+		if (components.size() == 1)
+		{
+			// Bundles, or a folder that was renamed or deleted as a whole. Loose files in the root are never loaded.
+			if (components[0].ends_with(ShaderBundleFormat::FileExtension) || components[0].find('.') == std::string::npos)
+				target.Type = PathTarget::Kind::Everything;
+		}
+		else if (components.size() == 2 && components[0] == ContainerDigestDirectoryName)
+		{
+			if (components[1].ends_with(".bin"))
+			{
+				const auto digest = DXContainer::DigestFromString(std::string_view(components[1]).substr(0, components[1].size() - 4));
+
+				if (digest)
+				{
+					target.Type = PathTarget::Kind::ContainerDigest;
+					target.ContainerDigest = *digest;
+				}
+			}
+		}
+		else if (components.size() == 2)
+		{
+			ShaderFileName fileName;
+
+			if (ParseShaderBinFileName(components[1], components[0], fileName))
+			{
+				target.Type = PathTarget::Kind::Technique;
+				target.TechniqueShortName = std::move(fileName.TechniqueShortName);
+				target.TechniqueId = fileName.TechniqueId;
+			}
+		}
+
+		return target;
+	}
+}
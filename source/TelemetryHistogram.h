@@ -0,0 +1,41 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+//
+// Pipeline creation time histogram used by the telemetry report. This header has no platform dependencies and is
+// shared with the tests.
+//
+namespace TelemetryHistogram
+{
+	// Inclusive upper bounds in microseconds. Everything slower lands in the last bucket.
+	constexpr std::array<uint32_t, 10> BucketBounds = { 250, 500, 1000, 2000, 4000, 8000, 16000, 32000, 64000, 128000 };
+	constexpr size_t BucketCount = BucketBounds.size() + 1;
+
+	inline size_t GetBucket(uint32_t Microseconds)
+	{
+		const auto itr = std::lower_bound(BucketBounds.begin(), BucketBounds.end(), Microseconds);
+		return static_cast<size_t>(std::distance(BucketBounds.begin(), itr));
+	}
+
+	class Histogram
+	{
+	private:
+		std::array<size_t, BucketCount> m_Counts = {};
+
+	public:
+		void Add(uint32_t Microseconds)
+		{
+			m_Counts[GetBucket(Microseconds)]++;
+		}
+
+		const std::array<size_t, BucketCount>& GetCounts() const
+		{
+			return m_Counts;
+		}
+	};
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <span>
+
+//
+// Selection of the N largest items for the hitch and telemetry reports. This header has no platform dependencies and
+// is shared with the tests.
+//
+namespace TopList
+{
+	// Moves the Count items with the largest Key to the front, largest first, and returns them. The order of the
+	// remaining items and of items with equal keys is unspecified.
+	template<typename T, typename F>
+	std::span<T> SelectLargest(std::span<T> Items, size_t Count, F&& Key)
+	{
+		const auto topCount = std::min(Items.size(), Count);
+
+		std::partial_sort(
+			Items.begin(),
+			Items.begin() + topCount,
+			Items.end(),
+			[&](const T& A, const T& B)
+			{
+				return Key(A) > Key(B);
+			});
+
+		return Items.first(topCount);
+	}
+}
@@ -0,0 +1,350 @@
+#include <cstdio>
+#include <initializer_list>
+#include <string>
+#include <utility>
+#include <vector>
+#include "DXContainer.h"
+#include "TestUtil.h"
+
+namespace DXContainerTests
+{
+	using DXContainer::MakeFourCC;
+
+	constexpr uint32_t ISGN = MakeFourCC('I', 'S', 'G', 'N');
+	constexpr uint32_t OSGN = MakeFourCC('O', 'S', 'G', 'N');
+	constexpr uint32_t ISG1 = MakeFourCC('I', 'S', 'G', '1');
+	constexpr uint32_t OSG1 = MakeFourCC('O', 'S', 'G', '1');
+	constexpr uint32_t PSG1 = MakeFourCC('P', 'S', 'G', '1');
+	constexpr uint32_t DXIL = MakeFourCC('D', 'X', 'I', 'L');
+	constexpr uint32_t STAT = MakeFourCC('S', 'T', 'A', 'T');
+
+	struct TestElement
+	{
+		const char *Name = "";
+		uint32_t Index = 0;
+		uint32_t SystemValue = 0;
+		uint32_t Register = 0;
+		uint8_t Mask = 0xF;
+	};
+
+	using TestPart = std::pair<uint32_t, std::vector<uint8_t>>;
+
+	template<typename T>
+	void Append(std::vector<uint8_t>& Output, const T& Value)
+	{
+		const auto bytes = reinterpret_cast<const uint8_t *>(&Value);
+		Output.insert(Output.end(), bytes, bytes + sizeof(T));
+	}
+
+	template<typename T>
+	void Overwrite(std::vector<uint8_t>& Output, size_t Offset, const T& Value)
+	{
+		memcpy(Output.data() + Offset, &Value, sizeof(T));
+	}
+
+	std::vector<uint8_t> BuildSignature(uint32_t FourCC, std::initializer_list<TestElement> Elements)
+	{
+		// Same layouts ParseSignature reads: DXIL signatures add a leading stream index and a trailing min precision
+		const bool isDXIL = FourCC == ISG1 || FourCC == OSG1 || FourCC == PSG1;
+		const uint32_t elementSize = isDXIL ? 32 : 24;
+		const uint32_t elementOffset = 8;
+
+		std::vector<uint8_t> names;
+		std::vector<uint8_t> output;
+
+		Append(output, static_cast<uint32_t>(Elements.size()));
+		Append(output, elementOffset);
+
+		const auto namesOffset = static_cast<uint32_t>(elementOffset + Elements.size() * elementSize);
+
+		for (const auto& element : Elements)
+		{
+			if (isDXIL)
+				Append(output, uint32_t(0));
+
+			Append(output, static_cast<uint32_t>(namesOffset + names.size()));
+			Append(output, element.Index);
+			Append(output, element.SystemValue);
+			Append(output, uint32_t(3)); // D3D_REGISTER_COMPONENT_FLOAT32
+			Append(output, element.Register);
+			Append(output, element.Mask);
+			Append(output, element.Mask);
+			Append(output, uint16_t(0));
+
+			if (isDXIL)
+				Append(output, uint32_t(0));
+
+			names.insert(names.end(), element.Name, element.Name + strlen(element.Name) + 1);
+		}
+
+		output.insert(output.end(), names.begin(), names.end());
+		return output;
+	}
+
+	std::vector<uint8_t> BuildContainer(const std::vector<TestPart>& Parts, bool Sign)
+	{
+		std::vector<uint8_t> output(sizeof(DXContainer::Header) + Parts.size() * sizeof(uint32_t));
+
+		for (size_t i = 0; i < Parts.size(); i++)
+		{
+			Overwrite(output, sizeof(DXContainer::Header) + i * sizeof(uint32_t), static_cast<uint32_t>(output.size()));
+			Append(output, Parts[i].first);
+			Append(output, static_cast<uint32_t>(Parts[i].second.size()));
+			output.insert(output.end(), Parts[i].second.begin(), Parts[i].second.end());
+		}
+
+		DXContainer::Header header = {};
+		header.Magic = DXContainer::Magic;
+		header.MajorVersion = 1;
+		header.MinorVersion = 0;
+		header.ContainerSize = static_cast<uint32_t>(output.size());
+		header.PartCount = static_cast<uint32_t>(Parts.size());
+		Overwrite(output, 0, header);
+
+		if (Sign)
+		{
+			const auto digest = DXContainer::ComputeRetailDigest(output);
+			Overwrite(output, offsetof(DXContainer::Header, Digest), digest.Low);
+			Overwrite(output, offsetof(DXContainer::Header, Digest) + 8, digest.High);
+		}
+
+		return output;
+	}
+
+	std::vector<uint8_t> BuildShader(std::vector<uint8_t> Inputs, std::vector<uint8_t> Outputs, bool Sign = true)
+	{
+		return BuildContainer(
+			{
+				{ ISG1, std::move(Inputs) },
+				{ OSG1, std::move(Outputs) },
+				{ DXIL, std::vector<uint8_t>(16, 0xCC) },
+			},
+			Sign);
+	}
+
+	void TestParse()
+	{
+		std::string error;
+		const auto data = BuildContainer({ { DXIL, { 1, 2, 3, 4 } }, { STAT, { 5, 6 } } }, true);
+		const auto container = DXContainer::Parse(data, error);
+
+		CHECK(container.has_value());
+		CHECK(container && container->Parts.size() == 2);
+		CHECK(container && container->Parts[0].FourCC == DXIL && container->Parts[0].Data.size() == 4);
+		CHECK(container && container->Parts[1].FourCC == STAT && container->Parts[1].Data[1] == 6);
+		CHECK(container && container->FindPart({ STAT }) == &container->Parts[1]);
+		CHECK(container && container->FindPart({ ISG1 }) == nullptr);
+		CHECK(container && container->Digest == DXContainer::GetDigest(data.data(), data.size()));
+
+		auto badMagic = data;
+		badMagic[0] = 'X';
+		CHECK(!DXContainer::Parse(badMagic, error));
+
+		auto badVersion = data;
+		Overwrite(badVersion, offsetof(DXContainer::Header, MajorVersion), uint16_t(2));
+		CHECK(!DXContainer::Parse(badVersion, error));
+
+		auto truncated = data;
+		truncated.pop_back();
+		CHECK(!DXContainer::Parse(truncated, error));
+		CHECK(!DXContainer::Parse(std::span(data).first(16), error));
+
+		// Part offset past the end of the container
+		auto badOffset = data;
+		Overwrite(badOffset, sizeof(DXContainer::Header), static_cast<uint32_t>(data.size()));
+		CHECK(!DXContainer::Parse(badOffset, error));
+
+		// Part size past the end of the container
+		auto badSize = data;
+		uint32_t secondPartOffset = 0;
+		memcpy(&secondPartOffset, data.data() + sizeof(DXContainer::Header) + 4, sizeof(secondPartOffset));
+		Overwrite(badSize, secondPartOffset + 4, uint32_t(0xFFFFFFF0));
+		CHECK(!DXContainer::Parse(badSize, error));
+
+		// More parts than the offset table holds
+		auto badCount = data;
+		Overwrite(badCount, offsetof(DXContainer::Header, PartCount), uint32_t(1000));
+		CHECK(!DXContainer::Parse(badCount, error));
+	}
+
+	void TestParseSignature()
+	{
+		for (const auto fourCC : { ISGN, ISG1 })
+		{
+			const auto data = BuildSignature(
+				fourCC,
+				{
+					{ .Name = "SV_Position", .SystemValue = 1, .Register = 0 },
+					{ .Name = "TEXCOORD", .Index = 3, .Register = 1, .Mask = 0x3 },
+				});
+
+			std::vector<DXContainer::SignatureElement> elements;
+
+			CHECK(DXContainer::ParseSignature({ .FourCC = fourCC, .Data = data }, elements));
+			CHECK(elements.size() == 2);
+
+			if (elements.size() != 2)
+				continue;
+
+			CHECK(elements[0].SemanticName == "SV_Position" && elements[0].SystemValue == 1);
+			CHECK(elements[1].SemanticName == "TEXCOORD" && elements[1].SemanticIndex == 3);
+			CHECK(elements[1].Register == 1 && elements[1].Mask == 0x3 && elements[1].ComponentType == 3);
+
+			// Element table cut short
+			std::vector<DXContainer::SignatureElement> unused;
+			CHECK(!DXContainer::ParseSignature({ .FourCC = fourCC, .Data = std::span(data).first(20) }, unused));
+
+			// Name outside of the part
+			auto badName = data;
+			Overwrite(badName, 8 + (fourCC == ISG1 ? 4 : 0), static_cast<uint32_t>(data.size()));
+			CHECK(!DXContainer::ParseSignature({ .FourCC = fourCC, .Data = badName }, unused));
+
+			// Name without a terminator
+			auto unterminated = data;
+			unterminated.pop_back();
+			CHECK(!DXContainer::ParseSignature({ .FourCC = fourCC, .Data = unterminated }, unused));
+		}
+
+		std::vector<DXContainer::SignatureElement> elements;
+		const auto empty = BuildSignature(ISG1, {});
+
+		CHECK(DXContainer::ParseSignature({ .FourCC = ISG1, .Data = empty }, elements) && elements.empty());
+		CHECK(!DXContainer::ParseSignature({ .FourCC = ISG1, .Data = std::span(empty).first(4) }, elements));
+	}
+
+	void TestIsCompatibleReplacement()
+	{
+		std::string error;
+
+		// Signatures don't matter on their own. A replacement may read and write different values than the original.
+		const auto replacement = BuildShader(
+			BuildSignature(ISG1, { { .Name = "TEXCOORD", .Index = 7 } }),
+			BuildSignature(OSG1, { { .Name = "SV_Target", .SystemValue = 64 } }));
+
+		CHECK(DXContainer::IsCompatibleReplacement(replacement, error));
+
+		const auto unsigned_ = BuildShader(BuildSignature(ISG1, {}), BuildSignature(OSG1, {}), false);
+		CHECK(!DXContainer::IsCompatibleReplacement(unsigned_, error));
+		CHECK(error.find("signed") != std::string::npos);
+
+		auto truncated = replacement;
+		truncated.resize(truncated.size() - 8);
+		CHECK(!DXContainer::IsCompatibleReplacement(truncated, error));
+
+		const std::vector<uint8_t> garbage(64, 0xAB);
+		CHECK(!DXContainer::IsCompatibleReplacement(garbage, error));
+		CHECK(!DXContainer::IsCompatibleReplacement({}, error));
+	}
+
+	void TestStageLinkage()
+	{
+		std::string error;
+
+		const auto vertexShader = BuildShader(
+			BuildSignature(ISG1, { { .Name = "POSITION" } }),
+			BuildSignature(
+				OSG1,
+				{
+					{ .Name = "SV_Position", .SystemValue = 1 },
+					{ .Name = "TEXCOORD", .Index = 0, .Register = 1 },
+					{ .Name = "COLOR", .Index = 0, .Register = 2 },
+				}));
+
+		const auto pixelShader = BuildShader(
+			BuildSignature(
+				ISG1,
+				{
+					{ .Name = "SV_Position", .SystemValue = 1 },
+					{ .Name = "texcoord", .Index = 0, .Register = 5 }, // Linked by semantic, not by register or case
+					{ .Name = "SV_IsFrontFace", .SystemValue = 9 },
+				}),
+			BuildSignature(OSG1, { { .Name = "SV_Target", .SystemValue = 64 } }));
+
+		const auto vs = DXContainer::Parse(vertexShader, error);
+		const auto ps = DXContainer::Parse(pixelShader, error);
+		CHECK(vs && ps);
+
+		if (!vs || !ps)
+			return;
+
+		const auto psInputs = DXContainer::GetInputSignature(*ps);
+		const auto vsOutputs = DXContainer::GetOutputSignature(*vs);
+		CHECK(psInputs && vsOutputs);
+		CHECK(DXContainer::AreInputsProvided(*psInputs, *vsOutputs, "vs", error));
+
+		// Reading a value the vertex shader doesn't write
+		const auto greedyPixelShader = BuildShader(
+			BuildSignature(ISG1, { { .Name = "TEXCOORD", .Index = 1 } }),
+			BuildSignature(OSG1, {}));
+		const auto greedy = DXContainer::Parse(greedyPixelShader, error);
+		CHECK(greedy);
+
+		if (greedy)
+		{
+			CHECK(!DXContainer::AreInputsProvided(*DXContainer::GetInputSignature(*greedy), *vsOutputs, "vs", error));
+			CHECK(error == "input TEXCOORD1 isn't provided by vs");
+		}
+
+		// Vertex shader inputs against an input layout
+		const std::vector<DXContainer::SignatureElement> layout = { { .SemanticName = "position" } };
+		const std::vector<DXContainer::SignatureElement> emptyLayout;
+		CHECK(DXContainer::AreInputsProvided(*DXContainer::GetInputSignature(*vs), layout, "the input layout", error));
+		CHECK(!DXContainer::AreInputsProvided(*DXContainer::GetInputSignature(*vs), emptyLayout, "the input layout", error));
+
+		// Per-primitive mesh shader outputs count as outputs
+		const auto meshShaderData = BuildContainer(
+			{
+				{ OSG1, BuildSignature(OSG1, { { .Name = "SV_Position", .SystemValue = 1 } }) },
+				{ PSG1, BuildSignature(PSG1, { { .Name = "TEXCOORD", .Index = 1 } }) },
+			},
+			true);
+		const auto meshShader = DXContainer::Parse(meshShaderData, error);
+		CHECK(meshShader);
+
+		if (meshShader && greedy)
+		{
+			const auto outputs = DXContainer::GetOutputSignature(*meshShader);
+			CHECK(outputs && outputs->size() == 2);
+			CHECK(outputs && DXContainer::AreInputsProvided(*DXContainer::GetInputSignature(*greedy), *outputs, "ms", error));
+		}
+
+		// Missing signatures can't be checked
+		const auto noSignatures = BuildContainer({ { DXIL, { 0 } } }, true);
+		const auto bare = DXContainer::Parse(noSignatures, error);
+		CHECK(bare && !DXContainer::GetInputSignature(*bare) && !DXContainer::GetOutputSignature(*bare));
+	}
+
+	void TestStripNonRuntimeParts()
+	{
+		std::string error;
+		const auto data = BuildContainer({ { DXIL, { 1, 2, 3, 4 } }, { STAT, std::vector<uint8_t>(100, 7) } }, true);
+		const auto stripped = DXContainer::StripNonRuntimeParts(data);
+
+		CHECK(stripped.has_value());
+
+		if (stripped)
+		{
+			const auto container = DXContainer::Parse(*stripped, error);
+
+			CHECK(container && container->Parts.size() == 1 && container->Parts[0].FourCC == DXIL);
+			CHECK(container && container->Digest == DXContainer::ComputeRetailDigest(*stripped));
+		}
+
+		// Nothing to strip, and unsigned containers are left alone
+		CHECK(!DXContainer::StripNonRuntimeParts(BuildContainer({ { DXIL, { 1 } } }, true)));
+		CHECK(!DXContainer::StripNonRuntimeParts(BuildContainer({ { DXIL, { 1 } }, { STAT, { 2 } } }, false)));
+	}
+}
+
+int main()
+{
+	using namespace DXContainerTests;
+
+	return TestUtil::RunTests({
+		{ "Parse", &TestParse },
+		{ "ParseSignature", &TestParseSignature },
+		{ "IsCompatibleReplacement", &TestIsCompatibleReplacement },
+		{ "StageLinkage", &TestStageLinkage },
+		{ "StripNonRuntimeParts", &TestStripNonRuntimeParts },
+	});
+}
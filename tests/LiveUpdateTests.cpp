@@ -0,0 +1,165 @@
+#include <chrono>
+#include <filesystem>
+#include <vector>
+#include "DXContainer.h"
+#include "LiveUpdateTracking.h"
+#include "ShaderPaths.h"
+#include "TestUtil.h"
+
+namespace LiveUpdateTests
+{
+	using ShaderPaths::PathTarget;
+	using namespace std::chrono_literals;
+
+	const ShaderDigest::Hash DigestA = { 0x0123456789ABCDEF, 0xFEDCBA9876543210 };
+	const ShaderDigest::Hash DigestB = { 1, 2 };
+
+	PathTarget MakeTechniqueTarget(const char *TechniqueShortName, uint64_t TechniqueId)
+	{
+		return { .Type = PathTarget::Kind::Technique, .TechniqueShortName = TechniqueShortName, .TechniqueId = TechniqueId };
+	}
+
+	PathTarget MakeDigestTarget(const ShaderDigest::Hash& Digest)
+	{
+		return { .Type = PathTarget::Kind::ContainerDigest, .ContainerDigest = Digest };
+	}
+
+	void TestClassifyTechniqueFiles()
+	{
+		const auto path = std::filesystem::path("Bloom") / "Bloom_1A2b_PS.bin";
+
+		CHECK(ShaderPaths::ClassifyPath(path) == MakeTechniqueTarget("bloom", 0x1A2B));
+		CHECK(ShaderPaths::ClassifyPath(std::filesystem::path("bloom") / "bloom_ff_rsg.bin") == MakeTechniqueTarget("bloom", 0xFF));
+
+		// Technique names can contain underscores
+		const auto underscores = std::filesystem::path("Color_Grading") / "Color_Grading_10_cs.bin";
+		CHECK(ShaderPaths::ClassifyPath(underscores) == MakeTechniqueTarget("color_grading", 0x10));
+
+		// Folder and file name have to agree, and the id and stage have to be valid
+		CHECK(ShaderPaths::ClassifyPath(std::filesystem::path("bloom") / "blur_10_ps.bin").Type == PathTarget::Kind::Ignored);
+		CHECK(ShaderPaths::ClassifyPath(std::filesystem::path("bloom") / "bloom_xyz_ps.bin").Type == PathTarget::Kind::Ignored);
+		CHECK(ShaderPaths::ClassifyPath(std::filesystem::path("bloom") / "bloom_10_xx.bin").Type == PathTarget::Kind::Ignored);
+		CHECK(ShaderPaths::ClassifyPath(std::filesystem::path("bloom") / "bloom_10_ps.txt").Type == PathTarget::Kind::Ignored);
+		CHECK(ShaderPaths::ClassifyPath(std::filesystem::path("bloom") / "bloom_ps.bin").Type == PathTarget::Kind::Ignored);
+		CHECK(ShaderPaths::ClassifyPath(std::filesystem::path("a") / "bloom" / "bloom_10_ps.bin").Type == PathTarget::Kind::Ignored);
+	}
+
+	void TestClassifyContainerDigestFiles()
+	{
+		const auto digestName = DXContainer::DigestToString(DigestA);
+
+		CHECK(ShaderPaths::ClassifyPath(std::filesystem::path("ByHash") / (digestName + ".bin")) == MakeDigestTarget(DigestA));
+		CHECK(ShaderPaths::ClassifyPath(std::filesystem::path("byhash") / (digestName + ".BIN")) == MakeDigestTarget(DigestA));
+
+		CHECK(ShaderPaths::ClassifyPath(std::filesystem::path("byhash") / (digestName + ".txt")).Type == PathTarget::Kind::Ignored);
+		CHECK(ShaderPaths::ClassifyPath(std::filesystem::path("byhash") / "0123.bin").Type == PathTarget::Kind::Ignored);
+	}
+
+	void TestClassifyRootEntries()
+	{
+		CHECK(ShaderPaths::ClassifyPath("Mod.ShaderBundle").Type == PathTarget::Kind::Everything);
+		CHECK(ShaderPaths::ClassifyPath("bloom").Type == PathTarget::Kind::Everything);
+		CHECK(ShaderPaths::ClassifyPath("byhash").Type == PathTarget::Kind::Everything);
+
+		// Loose files in the root are never loaded
+		CHECK(ShaderPaths::ClassifyPath("bloom_10_ps.bin").Type == PathTarget::Kind::Ignored);
+		CHECK(ShaderPaths::ClassifyPath("readme.txt").Type == PathTarget::Kind::Ignored);
+	}
+
+	void TestPipelineIndexLookups()
+	{
+		LiveUpdateTracking::PipelineIndex index;
+		const ShaderDigest::Hash digestsA[] = { DigestA, DigestA };
+		const ShaderDigest::Hash digestsB[] = { DigestB };
+
+		CHECK(index.Add("Bloom", 0x10, digestsA) == 0);
+		CHECK(index.Add("Blur", 0x10, digestsB) == 1);
+		CHECK(index.Add("bloom", 0x10, {}) == 2);
+		CHECK(index.Add("bloom", 0x20, digestsA) == 3);
+		CHECK(index.GetCount() == 4);
+
+		// Technique ids are shared between techniques. The short name has to match as well.
+		const PathTarget bloom[] = { MakeTechniqueTarget("bloom", 0x10) };
+		CHECK(index.Find(bloom) == std::vector<size_t>({ 0, 2 }));
+
+		const PathTarget unknown[] = { MakeTechniqueTarget("bloom", 0x30) };
+		CHECK(index.Find(unknown).empty());
+
+		// A shader used in several stages is only listed once
+		const PathTarget digestA[] = { MakeDigestTarget(DigestA) };
+		CHECK(index.Find(digestA) == std::vector<size_t>({ 0, 3 }));
+
+		// Results are merged, sorted and unique
+		const PathTarget combined[] = { MakeDigestTarget(DigestB), MakeTechniqueTarget("bloom", 0x10), MakeDigestTarget(DigestA) };
+		CHECK(index.Find(combined) == std::vector<size_t>({ 0, 1, 2, 3 }));
+
+		const PathTarget everything[] = { MakeTechniqueTarget("blur", 0x10), { .Type = PathTarget::Kind::Everything } };
+		CHECK(index.Find(everything) == std::vector<size_t>({ 0, 1, 2, 3 }));
+	}
+
+	void TestDebounceCoalescing()
+	{
+		LiveUpdateTracking::ChangeBatcher batcher;
+		const auto start = LiveUpdateTracking::ChangeBatcher::Clock::time_point();
+		const PathTarget first[] = { MakeTechniqueTarget("bloom", 0x10), { .Type = PathTarget::Kind::Ignored } };
+		const PathTarget second[] = { MakeDigestTarget(DigestA), MakeTechniqueTarget("bloom", 0x10) };
+
+		// Nothing pending: wait indefinitely
+		CHECK(!batcher.GetWaitTime(start));
+		CHECK(!batcher.IsReady(start));
+
+		batcher.Add(first, false, start);
+		CHECK(batcher.GetWaitTime(start) == LiveUpdateTracking::DebounceTime);
+		CHECK(!batcher.IsReady(start + 249ms));
+
+		// Every notification restarts the quiet period, including ones without any relevant files
+		batcher.Add(second, false, start + 200ms);
+		batcher.Add({}, false, start + 400ms);
+		CHECK(!batcher.IsReady(start + 600ms));
+		CHECK(batcher.GetWaitTime(start + 600ms) == 50ms);
+		CHECK(batcher.IsReady(start + 650ms));
+		CHECK(batcher.GetWaitTime(start + 700ms) == std::chrono::steady_clock::duration::zero());
+
+		const auto targets = batcher.Take();
+		CHECK(targets == std::vector<PathTarget>({ MakeTechniqueTarget("bloom", 0x10), MakeDigestTarget(DigestA) }));
+
+		// Taking a batch starts over
+		CHECK(!batcher.GetWaitTime(start + 700ms));
+		CHECK(!batcher.IsReady(start + 10s));
+		CHECK(batcher.Take().empty());
+	}
+
+	void TestDebounceCollapsesToEverything()
+	{
+		LiveUpdateTracking::ChangeBatcher batcher;
+		const auto start = LiveUpdateTracking::ChangeBatcher::Clock::time_point();
+		const PathTarget technique[] = { MakeTechniqueTarget("bloom", 0x10) };
+		const PathTarget bundle[] = { { .Type = PathTarget::Kind::Everything } };
+		const std::vector<PathTarget> everything = { { .Type = PathTarget::Kind::Everything } };
+
+		batcher.Add(technique, false, start);
+		batcher.Add(bundle, false, start);
+		CHECK(batcher.Take() == everything);
+
+		// Lost notifications affect everything even when nothing relevant was seen
+		batcher.Add(technique, false, start);
+		batcher.Add({}, true, start);
+		CHECK(batcher.HasLostChanges());
+		CHECK(batcher.Take() == everything);
+		CHECK(!batcher.HasLostChanges());
+	}
+}
+
+int main()
+{
+	using namespace LiveUpdateTests;
+
+	return TestUtil::RunTests({
+		{ "ClassifyTechniqueFiles", &TestClassifyTechniqueFiles },
+		{ "ClassifyContainerDigestFiles", &TestClassifyContainerDigestFiles },
+		{ "ClassifyRootEntries", &TestClassifyRootEntries },
+		{ "PipelineIndexLookups", &TestPipelineIndexLookups },
+		{ "DebounceCoalescing", &TestDebounceCoalescing },
+		{ "DebounceCollapsesToEverything", &TestDebounceCollapsesToEverything },
+	});
+}
@@ -0,0 +1,204 @@
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+#include "PipelineFingerprint.h"
+#include "TestUtil.h"
+
+namespace PipelineFingerprintTests
+{
+	// Matches the D3D12_PIPELINE_STATE_SUBOBJECT_TYPE values
+	constexpr uint32_t RootSignatureType = 0;
+	constexpr uint32_t VertexShaderType = 1;
+	constexpr uint32_t PixelShaderType = 2;
+	constexpr uint32_t InputLayoutType = 12;
+
+	ShaderDigest::Hash Fingerprint(const std::function<void(PipelineFingerprint::Builder&)>& Build)
+	{
+		PipelineFingerprint::Builder builder;
+		Build(builder);
+
+		return builder.Finish();
+	}
+
+	std::vector<uint8_t> MakeContainer(const ShaderDigest::Hash& Digest, uint8_t Fill)
+	{
+		std::vector<uint8_t> data(64, Fill);
+		DXContainer::Header header = {};
+
+		header.Magic = DXContainer::Magic;
+		memcpy(header.Digest, &Digest.Low, 8);
+		memcpy(header.Digest + 8, &Digest.High, 8);
+		header.ContainerSize = static_cast<uint32_t>(data.size());
+		memcpy(data.data(), &header, sizeof(header));
+
+		return data;
+	}
+
+	void TestPointersAreIgnored()
+	{
+		// Identical contents at different addresses
+		const std::vector<uint8_t> shaderA(100, 1);
+		const std::vector<uint8_t> shaderB(100, 1);
+		const char semanticA[] = "TEXCOORD";
+		const char semanticB[] = "TEXCOORD";
+
+		auto build = [](const std::vector<uint8_t>& Shader, const char *Semantic)
+		{
+			return Fingerprint(
+				[&](PipelineFingerprint::Builder& Builder)
+				{
+					Builder.BeginSubobject(VertexShaderType);
+					Builder.AddShader(Shader.data(), Shader.size());
+					Builder.BeginSubobject(InputLayoutType);
+					Builder.AddString(Semantic);
+				});
+		};
+
+		CHECK(build(shaderA, semanticA) == build(shaderB, semanticB));
+		CHECK(build(shaderA, semanticA) != build(std::vector<uint8_t>(100, 2), semanticA));
+		CHECK(build(shaderA, semanticA) != build(shaderA, "POSITION"));
+	}
+
+	void TestOrderMatters()
+	{
+		const std::vector<uint8_t> shaderA(100, 1);
+		const std::vector<uint8_t> shaderB(100, 2);
+
+		auto build = [](std::initializer_list<std::pair<uint32_t, const std::vector<uint8_t> *>> Subobjects)
+		{
+			return Fingerprint(
+				[&](PipelineFingerprint::Builder& Builder)
+				{
+					for (const auto& [type, shader] : Subobjects)
+					{
+						Builder.BeginSubobject(type);
+						Builder.AddShader(shader->data(), shader->size());
+					}
+				});
+		};
+
+		const auto original = build({ { VertexShaderType, &shaderA }, { PixelShaderType, &shaderB } });
+
+		CHECK(original == build({ { VertexShaderType, &shaderA }, { PixelShaderType, &shaderB } }));
+
+		// Same subobjects in a different order
+		CHECK(original != build({ { PixelShaderType, &shaderB }, { VertexShaderType, &shaderA } }));
+
+		// Same shaders in swapped stages
+		CHECK(original != build({ { VertexShaderType, &shaderB }, { PixelShaderType, &shaderA } }));
+
+		// Adjacent strings can't be split differently
+		const auto ab = Fingerprint(
+			[](PipelineFingerprint::Builder& Builder)
+			{
+				Builder.AddString("A");
+				Builder.AddString("BC");
+			});
+
+		const auto abc = Fingerprint(
+			[](PipelineFingerprint::Builder& Builder)
+			{
+				Builder.AddString("AB");
+				Builder.AddString("C");
+			});
+
+		CHECK(ab != abc);
+	}
+
+	void TestSignedContainersUseTheirDigest()
+	{
+		const ShaderDigest::Hash digest = { 0x1111, 0x2222 };
+
+		auto build = [](const std::vector<uint8_t>& Shader)
+		{
+			return Fingerprint(
+				[&](PipelineFingerprint::Builder& Builder)
+				{
+					Builder.BeginSubobject(PixelShaderType);
+					Builder.AddShader(Shader.data(), Shader.size());
+				});
+		};
+
+		// Contents aren't hashed again, only the embedded digest and the size
+		CHECK(build(MakeContainer(digest, 1)) == build(MakeContainer(digest, 2)));
+		CHECK(build(MakeContainer(digest, 1)) != build(MakeContainer({ 0x1111, 0x3333 }, 1)));
+
+		// Unsigned containers are hashed by content
+		CHECK(build(MakeContainer({}, 1)) != build(MakeContainer({}, 2)));
+
+		// A missing shader still occupies its stage
+		const auto pixelOnly = build(MakeContainer(digest, 1));
+		const auto withMissingVertex = Fingerprint(
+			[&](PipelineFingerprint::Builder& Builder)
+			{
+				const auto shader = MakeContainer(digest, 1);
+
+				Builder.BeginSubobject(VertexShaderType);
+				Builder.AddShader(nullptr, 0);
+				Builder.BeginSubobject(PixelShaderType);
+				Builder.AddShader(shader.data(), shader.size());
+			});
+
+		CHECK(pixelOnly != withMissingVertex);
+	}
+
+	void TestRootSignatureRules()
+	{
+		const int objectA = 0;
+		const int objectB = 0;
+		const ShaderDigest::Hash tagA = { 1, 1 };
+		const ShaderDigest::Hash tagB = { 2, 2 };
+		const std::vector<uint8_t> blobA(40, 1);
+		const std::vector<uint8_t> blobB(40, 2);
+		const std::span<const uint8_t> dataA(blobA);
+		const std::span<const uint8_t> dataB(blobB);
+
+		auto build = [](const void *Object, std::optional<ShaderDigest::Hash> Tag, const std::span<const uint8_t> *Data)
+		{
+			return Fingerprint(
+				[&](PipelineFingerprint::Builder& Builder)
+				{
+					Builder.BeginSubobject(RootSignatureType);
+					Builder.AddRootSignature(Object, Tag, Data);
+				});
+		};
+
+		// Tags take priority over everything else
+		CHECK(build(&objectA, tagA, &dataA) == build(&objectB, tagA, &dataB));
+		CHECK(build(&objectA, tagA, &dataA) != build(&objectA, tagB, &dataA));
+
+		// Untagged signatures are identified by their blob
+		CHECK(build(&objectA, std::nullopt, &dataA) == build(&objectB, std::nullopt, &dataA));
+		CHECK(build(&objectA, std::nullopt, &dataA) != build(&objectA, std::nullopt, &dataB));
+
+		// And by their address when the blob isn't known
+		CHECK(build(&objectA, std::nullopt, nullptr) == build(&objectA, std::nullopt, nullptr));
+		CHECK(build(&objectA, std::nullopt, nullptr) != build(&objectB, std::nullopt, nullptr));
+
+		// A null signature only contributes its type
+		const auto typeOnly = Fingerprint(
+			[](PipelineFingerprint::Builder& Builder)
+			{
+				Builder.BeginSubobject(RootSignatureType);
+			});
+
+		CHECK(build(nullptr, tagA, &dataA) == typeOnly);
+	}
+}
+
+int main()
+{
+	using namespace PipelineFingerprintTests;
+
+	return TestUtil::RunTests({
+		{ "PointersAreIgnored", &TestPointersAreIgnored },
+		{ "OrderMatters", &TestOrderMatters },
+		{ "SignedContainersUseTheirDigest", &TestSignedContainersUseTheirDigest },
+		{ "RootSignatureRules", &TestRootSignatureRules },
+	});
+}
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "PipelinePrewarmFormat.h"
+#include "TestUtil.h"
+
+namespace PipelinePrewarmTests
+{
+	struct Manifest
+	{
+		std::vector<std::vector<uint8_t>> BlobData;
+		std::vector<PipelinePrewarmFormat::BlobView> Blobs;
+		std::vector<PipelinePrewarmFormat::EntryView> Entries;
+		std::vector<uint8_t> Streams[2];
+	};
+
+	void MakeManifest(Manifest& Output)
+	{
+		// Two pipelines sharing a root signature blob. The second pipeline has no name.
+		Output.BlobData = { { 1, 2, 3, 4, 5 }, std::vector<uint8_t>(300, 0xAB), { 9 } };
+
+		for (const auto& data : Output.BlobData)
+			Output.Blobs.emplace_back(PipelinePrewarmFormat::BlobView { ShaderDigest::Compute(data.data(), data.size()), data });
+
+		Output.Streams[0] = { 10, 11, 12 };
+		Output.Streams[1] = std::vector<uint8_t>(77, 0x55);
+
+		PipelinePrewarmFormat::EntryHeader first {
+			.TechniqueId = 0x1234,
+			.PatchedFingerprint = { 1, 1 },
+			.RootSignatureDigest = Output.Blobs[2].Digest,
+		};
+
+		PipelinePrewarmFormat::EntryHeader second {
+			.TechniqueId = 0xFFFFFFFF00000001,
+			.PatchedFingerprint = { 2, 2 },
+			.RootSignatureDigest = Output.Blobs[2].Digest,
+		};
+
+		Output.Entries.emplace_back(PipelinePrewarmFormat::EntryView { first, "Bloom_PS_1234", Output.Streams[0] });
+		Output.Entries.emplace_back(PipelinePrewarmFormat::EntryView { second, "", Output.Streams[1] });
+	}
+
+	bool Parse(const std::vector<uint8_t>& Data)
+	{
+		PipelinePrewarmFormat::BlobViewMap blobs;
+		std::vector<PipelinePrewarmFormat::EntryView> entries;
+
+		return PipelinePrewarmFormat::Parse(Data, blobs, entries);
+	}
+
+	void TestRoundTrip()
+	{
+		Manifest manifest;
+		MakeManifest(manifest);
+
+		const auto data = PipelinePrewarmFormat::Write(manifest.Blobs, manifest.Entries);
+		PipelinePrewarmFormat::BlobViewMap blobs;
+		std::vector<PipelinePrewarmFormat::EntryView> entries;
+
+		CHECK(PipelinePrewarmFormat::Parse(data, blobs, entries));
+		CHECK(blobs.size() == manifest.Blobs.size());
+		CHECK(entries.size() == manifest.Entries.size());
+
+		for (const auto& blob : manifest.Blobs)
+		{
+			const auto itr = blobs.find(blob.Digest);
+			CHECK(itr != blobs.end() && std::ranges::equal(itr->second, blob.Data));
+		}
+
+		for (size_t i = 0; i < entries.size() && i < manifest.Entries.size(); i++)
+		{
+			const auto& expected = manifest.Entries[i];
+			const auto& entry = entries[i];
+
+			CHECK(entry.Header.TechniqueId == expected.Header.TechniqueId);
+			CHECK(entry.Header.PatchedFingerprint == expected.Header.PatchedFingerprint);
+			CHECK(entry.Header.RootSignatureDigest == expected.Header.RootSignatureDigest);
+			CHECK(entry.Header.NameLength == expected.Name.size());
+			CHECK(entry.Header.StreamSize == expected.Stream.size());
+			CHECK(entry.Name == expected.Name);
+			CHECK(entry.Name.data()[entry.Name.size()] == '\0');
+			CHECK(std::ranges::equal(entry.Stream, expected.Stream));
+		}
+
+		// Empty manifests are valid
+		CHECK(Parse(PipelinePrewarmFormat::Write({}, {})));
+	}
+
+	void TestRejectsBadHeaders()
+	{
+		Manifest manifest;
+		MakeManifest(manifest);
+
+		const auto data = PipelinePrewarmFormat::Write(manifest.Blobs, manifest.Entries);
+
+		auto modified = [&](size_t Offset, auto Value)
+		{
+			auto copy = data;
+			memcpy(copy.data() + Offset, &Value, sizeof(Value));
+
+			return copy;
+		};
+
+		const auto nextVersion = PipelinePrewarmFormat::FileHeader::ExpectedVersion + 1;
+
+		CHECK(!Parse({}));
+		CHECK(!Parse(modified(offsetof(PipelinePrewarmFormat::FileHeader, Magic), uint32_t(0))));
+		CHECK(!Parse(modified(offsetof(PipelinePrewarmFormat::FileHeader, Version), nextVersion)));
+
+		// Counts that don't match the contents
+		CHECK(!Parse(modified(offsetof(PipelinePrewarmFormat::FileHeader, BlobCount), uint32_t(4))));
+		CHECK(!Parse(modified(offsetof(PipelinePrewarmFormat::FileHeader, BlobCount), uint32_t(2))));
+		CHECK(!Parse(modified(offsetof(PipelinePrewarmFormat::FileHeader, EntryCount), uint32_t(3))));
+		CHECK(!Parse(modified(offsetof(PipelinePrewarmFormat::FileHeader, EntryCount), uint32_t(0xFFFFFFFF))));
+	}
+
+	void TestRejectsTruncatedFiles()
+	{
+		Manifest manifest;
+		MakeManifest(manifest);
+
+		const auto data = PipelinePrewarmFormat::Write(manifest.Blobs, manifest.Entries);
+		bool anyAccepted = false;
+
+		for (size_t size = 0; size < data.size(); size++)
+			anyAccepted |= Parse({ data.begin(), data.begin() + size });
+
+		CHECK(!anyAccepted);
+
+		// Trailing data means the counts are off
+		auto extended = data;
+		extended.emplace_back(0);
+
+		CHECK(!Parse(extended));
+	}
+
+	void TestRejectsCorruptContents()
+	{
+		Manifest manifest;
+		MakeManifest(manifest);
+
+		const auto data = PipelinePrewarmFormat::Write(manifest.Blobs, manifest.Entries);
+		const auto firstBlob = sizeof(PipelinePrewarmFormat::FileHeader);
+		const auto firstEntry = PipelinePrewarmFormat::Write(manifest.Blobs, {}).size();
+
+		// Flipped bit in a blob's data
+		auto corrupted = data;
+		corrupted[firstBlob + sizeof(PipelinePrewarmFormat::BlobHeader)] ^= 1;
+		CHECK(!Parse(corrupted));
+
+		// Blob size running past the end
+		corrupted = data;
+		const auto blobSize = ~uint64_t(0);
+		memcpy(corrupted.data() + firstBlob + offsetof(PipelinePrewarmFormat::BlobHeader, Size), &blobSize, sizeof(blobSize));
+		CHECK(!Parse(corrupted));
+
+		// Missing name terminator
+		corrupted = data;
+		corrupted[firstEntry + sizeof(PipelinePrewarmFormat::EntryHeader) + manifest.Entries[0].Name.size()] = 'x';
+		CHECK(!Parse(corrupted));
+
+		// Name and stream sizes running past the end
+		const size_t sizeOffsets[] = {
+			offsetof(PipelinePrewarmFormat::EntryHeader, NameLength),
+			offsetof(PipelinePrewarmFormat::EntryHeader, StreamSize),
+		};
+
+		for (const auto offset : sizeOffsets)
+		{
+			corrupted = data;
+			const auto size = uint32_t(0xFFFFFFFF);
+			memcpy(corrupted.data() + firstEntry + offset, &size, sizeof(size));
+			CHECK(!Parse(corrupted));
+		}
+	}
+}
+
+int main()
+{
+	using namespace PipelinePrewarmTests;
+
+	return TestUtil::RunTests({
+		{ "RoundTrip", &TestRoundTrip },
+		{ "RejectsBadHeaders", &TestRejectsBadHeaders },
+		{ "RejectsTruncatedFiles", &TestRejectsTruncatedFiles },
+		{ "RejectsCorruptContents", &TestRejectsCorruptContents },
+	});
+}
@@ -0,0 +1,272 @@
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <lz4.h>
+#include "ShaderBundleFormat.h"
+#include "ShaderBundleWriter.h"
+#include "TestUtil.h"
+
+namespace ShaderBundleTests
+{
+	using ShaderBundleTool::PackedShader;
+
+	PackedShader MakeShader(
+		const char *TechniqueShortName,
+		uint64_t TechniqueId,
+		ShaderBundleFormat::Stage Stage,
+		std::vector<uint8_t> Data)
+	{
+		PackedShader shader;
+		shader.TechniqueShortName = TechniqueShortName;
+		shader.TechniqueId = TechniqueId;
+		shader.Stage = Stage;
+		shader.Data = std::move(Data);
+		shader.Digest = ShaderDigest::Compute(shader.Data.data(), shader.Data.size());
+
+		return shader;
+	}
+
+	std::vector<uint8_t> MakeData(size_t Size, uint32_t Seed, bool Compressible)
+	{
+		std::vector<uint8_t> data(Size);
+
+		for (size_t i = 0; i < Size; i++)
+		{
+			Seed = Seed * 1664525 + 1013904223;
+			data[i] = Compressible ? static_cast<uint8_t>(i / 64) : static_cast<uint8_t>(Seed >> 24);
+		}
+
+		return data;
+	}
+
+	std::vector<PackedShader> MakeShaders()
+	{
+		// Sorted the way the tool sorts them. Two entries share a blob.
+		std::vector<PackedShader> shaders;
+		shaders.emplace_back(MakeShader("bloom", 0x10, ShaderBundleFormat::Stage::RootSignature, MakeData(100, 1, false)));
+		shaders.emplace_back(MakeShader("bloom", 0x10, ShaderBundleFormat::Stage::Vertex, MakeData(4096, 2, true)));
+		shaders.emplace_back(MakeShader("bloom", 0x10, ShaderBundleFormat::Stage::Pixel, MakeData(3000, 3, false)));
+		shaders.emplace_back(MakeShader("colorgrading", 0xFF81, ShaderBundleFormat::Stage::Compute, MakeData(4096, 2, true)));
+
+		return shaders;
+	}
+
+	std::vector<uint8_t> Pack(const std::vector<PackedShader>& Shaders, bool Compress)
+	{
+		const auto path = std::filesystem::temp_directory_path() / "ShaderBundleTests.shaderbundle";
+		std::vector<uint8_t> data;
+
+		if (ShaderBundleTool::WriteBundle(path, Shaders, Compress))
+		{
+			std::ifstream f(path, std::ios::binary);
+			data.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+		}
+
+		std::error_code ec;
+		std::filesystem::remove(path, ec);
+
+		return data;
+	}
+
+	std::vector<uint8_t> Expand(const ShaderBundleFormat::ParsedEntry& Entry)
+	{
+		if (Entry.Info->BlobCompression == ShaderBundleFormat::Compression::None)
+			return { Entry.Data.begin(), Entry.Data.end() };
+
+		std::vector<uint8_t> output(Entry.Info->UncompressedSize);
+		const auto result = LZ4_decompress_safe(
+			reinterpret_cast<const char *>(Entry.Data.data()),
+			reinterpret_cast<char *>(output.data()),
+			static_cast<int>(Entry.Data.size()),
+			static_cast<int>(output.size()));
+
+		if (result < 0 || static_cast<size_t>(result) != output.size())
+			return {};
+
+		return output;
+	}
+
+	void CheckRoundTrip(bool Compress)
+	{
+		const auto shaders = MakeShaders();
+		const auto bundle = Pack(shaders, Compress);
+		std::vector<ShaderBundleFormat::ParsedEntry> entries;
+		size_t skippedEntries = 0;
+
+		CHECK(!bundle.empty());
+		CHECK(ShaderBundleFormat::Parse(bundle, entries, skippedEntries));
+		CHECK(skippedEntries == 0);
+		CHECK(entries.size() == shaders.size());
+
+		for (size_t i = 0; i < entries.size() && i < shaders.size(); i++)
+		{
+			const auto& entry = entries[i];
+			const auto data = Expand(entry);
+
+			CHECK(entry.TechniqueShortName == shaders[i].TechniqueShortName);
+			CHECK(entry.Info->TechniqueId == shaders[i].TechniqueId);
+			CHECK(entry.Info->ShaderStage == shaders[i].Stage);
+			CHECK(entry.Info->Digest == shaders[i].Digest);
+			CHECK(entry.Info->DataOffset % ShaderBundleFormat::BlobAlignment == 0);
+			CHECK(data == shaders[i].Data);
+		}
+
+		// Identical blobs are stored once
+		if (entries.size() == 4)
+			CHECK(entries[1].Info->DataOffset == entries[3].Info->DataOffset);
+
+		// Only compressible blobs are compressed
+		if (Compress && entries.size() == 4)
+		{
+			CHECK(entries[1].Info->BlobCompression == ShaderBundleFormat::Compression::LZ4);
+			CHECK(entries[2].Info->BlobCompression == ShaderBundleFormat::Compression::None);
+		}
+	}
+
+	void TestRoundTrip()
+	{
+		CheckRoundTrip(false);
+	}
+
+	void TestCompressedRoundTrip()
+	{
+		CheckRoundTrip(true);
+	}
+
+	void TestRejectsBadHeaders()
+	{
+		const auto bundle = Pack(MakeShaders(), false);
+		std::vector<ShaderBundleFormat::ParsedEntry> entries;
+		size_t skippedEntries = 0;
+
+		auto parse = [&](const std::vector<uint8_t>& Data)
+		{
+			return ShaderBundleFormat::Parse(Data, entries, skippedEntries);
+		};
+
+		auto modified = [&](size_t Offset, auto Value)
+		{
+			auto copy = bundle;
+			memcpy(copy.data() + Offset, &Value, sizeof(Value));
+
+			return copy;
+		};
+
+		CHECK(!parse({}));
+		CHECK(!parse({ bundle.begin(), bundle.begin() + sizeof(ShaderBundleFormat::Header) - 1 }));
+		CHECK(!parse(modified(offsetof(ShaderBundleFormat::Header, Magic), uint32_t(0))));
+		CHECK(!parse(modified(offsetof(ShaderBundleFormat::Header, Version), ShaderBundleFormat::CurrentVersion + 1)));
+
+		// Tables running past the end of the file
+		CHECK(!parse(modified(offsetof(ShaderBundleFormat::Header, EntryCount), uint32_t(0x10000000))));
+		CHECK(!parse(modified(offsetof(ShaderBundleFormat::Header, EntriesOffset), uint64_t(bundle.size()))));
+		CHECK(!parse(modified(offsetof(ShaderBundleFormat::Header, NamesSize), uint64_t(bundle.size()))));
+		CHECK(!parse(modified(offsetof(ShaderBundleFormat::Header, NamesOffset), ~uint64_t(0))));
+
+		// Truncated after the tables: every blob is out of range
+		const auto firstEntry = reinterpret_cast<const ShaderBundleFormat::Entry *>(bundle.data() + sizeof(ShaderBundleFormat::Header));
+		const auto blobStart = firstEntry->DataOffset;
+
+		CHECK(parse({ bundle.begin(), bundle.begin() + blobStart }));
+		CHECK(entries.empty());
+		CHECK(skippedEntries == 4);
+	}
+
+	void TestRejectsBadEntries()
+	{
+		const auto bundle = Pack(MakeShaders(), false);
+		std::vector<ShaderBundleFormat::ParsedEntry> entries;
+		size_t skippedEntries = 0;
+
+		auto parseWithEntry = [&](size_t Index, auto&& Modify)
+		{
+			auto copy = bundle;
+			auto entry = reinterpret_cast<ShaderBundleFormat::Entry *>(copy.data() + sizeof(ShaderBundleFormat::Header)) + Index;
+			Modify(*entry);
+
+			// The other entries are unaffected
+			return ShaderBundleFormat::Parse(copy, entries, skippedEntries) && skippedEntries == 1 && entries.size() == 3;
+		};
+
+		CHECK(parseWithEntry(
+			0,
+			[](ShaderBundleFormat::Entry& Entry)
+			{
+				Entry.DataOffset = ~uint64_t(0);
+			}));
+
+		CHECK(parseWithEntry(
+			1,
+			[&](ShaderBundleFormat::Entry& Entry)
+			{
+				Entry.DataSize = bundle.size();
+			}));
+
+		CHECK(parseWithEntry(
+			2,
+			[](ShaderBundleFormat::Entry& Entry)
+			{
+				Entry.DataSize = 0;
+			}));
+
+		CHECK(parseWithEntry(
+			3,
+			[](ShaderBundleFormat::Entry& Entry)
+			{
+				Entry.NameOffset = 0xFFFFFFFF;
+			}));
+
+		CHECK(parseWithEntry(
+			0,
+			[](ShaderBundleFormat::Entry& Entry)
+			{
+				Entry.NameLength = 0xFFFF;
+			}));
+
+		CHECK(parseWithEntry(
+			1,
+			[](ShaderBundleFormat::Entry& Entry)
+			{
+				Entry.ShaderStage = ShaderBundleFormat::Stage::Count;
+			}));
+
+		CHECK(parseWithEntry(
+			2,
+			[](ShaderBundleFormat::Entry& Entry)
+			{
+				Entry.BlobCompression = static_cast<ShaderBundleFormat::Compression>(7);
+			}));
+
+		CHECK(parseWithEntry(
+			3,
+			[](ShaderBundleFormat::Entry& Entry)
+			{
+				Entry.UncompressedSize++;
+			}));
+
+		CHECK(parseWithEntry(
+			0,
+			[](ShaderBundleFormat::Entry& Entry)
+			{
+				Entry.BlobCompression = ShaderBundleFormat::Compression::LZ4;
+				Entry.UncompressedSize = 0;
+			}));
+	}
+}
+
+int main()
+{
+	using namespace ShaderBundleTests;
+
+	return TestUtil::RunTests({
+		{ "RoundTrip", &TestRoundTrip },
+		{ "CompressedRoundTrip", &TestCompressedRoundTrip },
+		{ "RejectsBadHeaders", &TestRejectsBadHeaders },
+		{ "RejectsBadEntries", &TestRejectsBadEntries },
+	});
+}
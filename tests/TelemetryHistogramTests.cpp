@@ -0,0 +1,69 @@
+#include <cstdint>
+#include <numeric>
+#include "TelemetryHistogram.h"
+#include "TestUtil.h"
+
+namespace TelemetryHistogramTests
+{
+	void TestBucketBoundaries()
+	{
+		// Upper bounds are inclusive
+		CHECK(TelemetryHistogram::GetBucket(0) == 0);
+		CHECK(TelemetryHistogram::GetBucket(250) == 0);
+		CHECK(TelemetryHistogram::GetBucket(251) == 1);
+		CHECK(TelemetryHistogram::GetBucket(500) == 1);
+		CHECK(TelemetryHistogram::GetBucket(999) == 2);
+		CHECK(TelemetryHistogram::GetBucket(1000) == 2);
+		CHECK(TelemetryHistogram::GetBucket(1001) == 3);
+
+		for (size_t i = 0; i < TelemetryHistogram::BucketBounds.size(); i++)
+		{
+			CHECK(TelemetryHistogram::GetBucket(TelemetryHistogram::BucketBounds[i]) == i);
+			CHECK(TelemetryHistogram::GetBucket(TelemetryHistogram::BucketBounds[i] + 1) == i + 1);
+		}
+	}
+
+	void TestOverflowBucket()
+	{
+		const auto last = TelemetryHistogram::BucketCount - 1;
+
+		CHECK(TelemetryHistogram::GetBucket(TelemetryHistogram::BucketBounds.back() + 1) == last);
+		CHECK(TelemetryHistogram::GetBucket(10'000'000) == last);
+		CHECK(TelemetryHistogram::GetBucket(UINT32_MAX) == last);
+	}
+
+	void TestBoundsAreSorted()
+	{
+		// lower_bound relies on it
+		for (size_t i = 1; i < TelemetryHistogram::BucketBounds.size(); i++)
+			CHECK(TelemetryHistogram::BucketBounds[i - 1] < TelemetryHistogram::BucketBounds[i]);
+	}
+
+	void TestCounts()
+	{
+		TelemetryHistogram::Histogram histogram;
+
+		for (const uint32_t time : { 10u, 250u, 300u, 300u, 128000u, 128001u, 5'000'000u })
+			histogram.Add(time);
+
+		const auto& counts = histogram.GetCounts();
+
+		CHECK(counts[0] == 2);
+		CHECK(counts[1] == 2);
+		CHECK(counts[TelemetryHistogram::BucketCount - 2] == 1);
+		CHECK(counts[TelemetryHistogram::BucketCount - 1] == 2);
+		CHECK(std::accumulate(counts.begin(), counts.end(), size_t(0)) == 7);
+	}
+}
+
+int main()
+{
+	using namespace TelemetryHistogramTests;
+
+	return TestUtil::RunTests({
+		{ "BucketBoundaries", &TestBucketBoundaries },
+		{ "OverflowBucket", &TestOverflowBucket },
+		{ "BoundsAreSorted", &TestBoundsAreSorted },
+		{ "Counts", &TestCounts },
+	});
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdio>
+#include <initializer_list>
+#include <utility>
+
+//
+// Minimal test harness shared by every test executable. CHECK() records failures without stopping the test so that
+// one run reports everything that's broken.
+//
+namespace TestUtil
+{
+	inline int FailureCount = 0;
+
+	inline int RunTests(std::initializer_list<std::pair<const char *, void (*)()>> Tests)
+	{
+		for (const auto& [name, test] : Tests)
+		{
+			const int previousFailures = FailureCount;
+			test();
+
+			printf("%s: %s\n", name, FailureCount == previousFailures ? "passed" : "FAILED");
+		}
+
+		return FailureCount == 0 ? 0 : 1;
+	}
+}
+
+#define CHECK(Expression) \
+	do \
+	{ \
+		if (!(Expression)) \
+		{ \
+			fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #Expression); \
+			TestUtil::FailureCount++; \
+		} \
+	} while (0)
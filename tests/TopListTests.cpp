@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <span>
+#include <vector>
+#include "TopList.h"
+#include "TestUtil.h"
+
+namespace TopListTests
+{
+	struct Event
+	{
+		uint32_t Id = 0;
+		uint32_t Duration = 0;
+	};
+
+	std::vector<Event> MakeEvents(std::initializer_list<uint32_t> Durations)
+	{
+		std::vector<Event> events;
+
+		for (const auto duration : Durations)
+			events.emplace_back(Event { static_cast<uint32_t>(events.size()), duration });
+
+		return events;
+	}
+
+	std::vector<uint32_t> SelectDurations(std::vector<Event>& Events, size_t Count)
+	{
+		const auto top = TopList::SelectLargest(
+			std::span(Events),
+			Count,
+			[](const Event& Value)
+			{
+				return Value.Duration;
+			});
+
+		std::vector<uint32_t> durations;
+
+		for (const auto& event : top)
+			durations.emplace_back(event.Duration);
+
+		return durations;
+	}
+
+	void TestSelectsLargestFirst()
+	{
+		auto events = MakeEvents({ 5, 900, 3, 40, 7000, 12, 40, 1 });
+
+		CHECK(SelectDurations(events, 3) == std::vector<uint32_t>({ 7000, 900, 40 }));
+
+		// The selection is moved to the front and nothing is lost
+		CHECK(events[0].Id == 4 && events[1].Id == 1);
+		CHECK(events.size() == 8);
+
+		std::vector<uint32_t> ids;
+
+		for (const auto& event : events)
+			ids.emplace_back(event.Id);
+
+		std::sort(ids.begin(), ids.end());
+		CHECK(ids == std::vector<uint32_t>({ 0, 1, 2, 3, 4, 5, 6, 7 }));
+	}
+
+	void TestCountLimits()
+	{
+		auto events = MakeEvents({ 5, 900, 3 });
+
+		// Fewer items than requested: everything, still sorted
+		CHECK(SelectDurations(events, 10) == std::vector<uint32_t>({ 900, 5, 3 }));
+		CHECK(SelectDurations(events, 0).empty());
+
+		std::vector<Event> empty;
+		CHECK(SelectDurations(empty, 10).empty());
+	}
+
+	void TestLargeFrames()
+	{
+		// A loading screen's worth of events with the slowest ones at the very end
+		std::vector<Event> events;
+
+		for (uint32_t i = 0; i < 4096; i++)
+			events.emplace_back(Event { i, i % 100 });
+
+		events.back().Duration = 50'000;
+		events[4094].Duration = 20'000;
+
+		const auto durations = SelectDurations(events, 10);
+
+		CHECK(durations.size() == 10);
+		CHECK(durations[0] == 50'000 && durations[1] == 20'000);
+		CHECK(std::all_of(
+			durations.begin() + 2,
+			durations.end(),
+			[](uint32_t Duration)
+			{
+				return Duration == 99;
+			}));
+	}
+}
+
+int main()
+{
+	using namespace TopListTests;
+
+	return TestUtil::RunTests({
+		{ "SelectsLargestFirst", &TestSelectsLargestFirst },
+		{ "CountLimits", &TestCountLimits },
+		{ "LargeFrames", &TestLargeFrames },
+	});
+}
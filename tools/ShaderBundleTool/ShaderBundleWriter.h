@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <lz4.h>
+#include <lz4hc.h>
+#include "ShaderBundleFormat.h"
+
+//
+// Writes shader bundles in the layout described by ShaderBundleFormat.h. Kept apart from the command line handling so
+// that the tests can pack bundles.
+//
+namespace ShaderBundleTool
+{
+	struct PackedShader
+	{
+		std::string TechniqueShortName;
+		uint64_t TechniqueId = 0;
+		ShaderBundleFormat::Stage Stage = {};
+		std::filesystem::path Path;
+		std::vector<uint8_t> Data;
+		ShaderDigest::Hash Digest;
+	};
+
+	inline uint64_t AlignUp(uint64_t Value, uint64_t Alignment)
+	{
+		return (Value + (Alignment - 1)) & ~(Alignment - 1);
+	}
+
+	struct StoredBlob
+	{
+		uint64_t Offset = 0;
+		ShaderBundleFormat::Compression BlobCompression = ShaderBundleFormat::Compression::None;
+		std::vector<uint8_t> CompressedData;
+		const PackedShader *Source = nullptr;
+
+		std::span<const uint8_t> GetStoredData() const
+		{
+			if (BlobCompression == ShaderBundleFormat::Compression::None)
+				return Source->Data;
+
+			return CompressedData;
+		}
+	};
+
+	inline void CompressBlob(StoredBlob& Blob)
+	{
+		// Compression happens offline so the slowest high compression level is fine. Decompression speed is the
+		// same regardless of level.
+		const auto& input = Blob.Source->Data;
+
+		if (input.size() > LZ4_MAX_INPUT_SIZE)
+			return;
+
+		Blob.CompressedData.resize(LZ4_compressBound(static_cast<int>(input.size())));
+
+		const auto compressedSize = LZ4_compress_HC(
+			reinterpret_cast<const char *>(input.data()),
+			reinterpret_cast<char *>(Blob.CompressedData.data()),
+			static_cast<int>(input.size()),
+			static_cast<int>(Blob.CompressedData.size()),
+			LZ4HC_CLEVEL_MAX);
+
+		// Incompressible blobs are stored as is
+		if (compressedSize <= 0 || static_cast<size_t>(compressedSize) >= input.size())
+		{
+			Blob.CompressedData.clear();
+			return;
+		}
+
+		Blob.CompressedData.resize(compressedSize);
+		Blob.BlobCompression = ShaderBundleFormat::Compression::LZ4;
+	}
+
+	inline bool WriteBundle(const std::filesystem::path& OutputPath, const std::vector<PackedShader>& Shaders, bool Compress)
+	{
+		std::vector<ShaderBundleFormat::Entry> entries(Shaders.size());
+		std::string names;
+		std::unordered_map<std::string, uint32_t> nameOffsets;
+
+		for (size_t i = 0; i < Shaders.size(); i++)
+		{
+			const auto& shader = Shaders[i];
+			auto [itr, inserted] = nameOffsets.try_emplace(shader.TechniqueShortName, static_cast<uint32_t>(names.size()));
+
+			if (inserted)
+				names += shader.TechniqueShortName;
+
+			entries[i] = {
+				.TechniqueId = shader.TechniqueId,
+				.NameOffset = itr->second,
+				.NameLength = static_cast<uint16_t>(shader.TechniqueShortName.size()),
+				.ShaderStage = shader.Stage,
+				.BlobCompression = ShaderBundleFormat::Compression::None,
+				.DataOffset = 0,
+				.DataSize = shader.Data.size(),
+				.UncompressedSize = shader.Data.size(),
+				.Digest = shader.Digest,
+			};
+		}
+
+		ShaderBundleFormat::Header header {
+			.Magic = ShaderBundleFormat::Magic,
+			.Version = ShaderBundleFormat::CurrentVersion,
+			.EntryCount = static_cast<uint32_t>(entries.size()),
+			.Reserved = 0,
+			.EntriesOffset = sizeof(ShaderBundleFormat::Header),
+			.NamesOffset = sizeof(ShaderBundleFormat::Header) + entries.size() * sizeof(ShaderBundleFormat::Entry),
+			.NamesSize = names.size(),
+		};
+
+		// Identical shaders are common across techniques and only get stored (and compressed) once
+		std::unordered_map<ShaderDigest::Hash, StoredBlob, ShaderDigest::Hasher> blobs;
+		std::vector<StoredBlob *> uniqueBlobs;
+
+		for (const auto& shader : Shaders)
+		{
+			auto [itr, inserted] = blobs.try_emplace(shader.Digest);
+
+			if (inserted)
+			{
+				itr->second.Source = &shader;
+				uniqueBlobs.emplace_back(&itr->second);
+			}
+		}
+
+		if (Compress)
+		{
+			std::for_each(
+				std::execution::par,
+				uniqueBlobs.begin(),
+				uniqueBlobs.end(),
+				[](StoredBlob *Blob)
+				{
+					CompressBlob(*Blob);
+				});
+		}
+
+		uint64_t dataEnd = AlignUp(header.NamesOffset + header.NamesSize, ShaderBundleFormat::BlobAlignment);
+		uint64_t uncompressedEnd = dataEnd;
+
+		for (auto blob : uniqueBlobs)
+		{
+			blob->Offset = dataEnd;
+			dataEnd = AlignUp(dataEnd + blob->GetStoredData().size(), ShaderBundleFormat::BlobAlignment);
+			uncompressedEnd = AlignUp(uncompressedEnd + blob->Source->Data.size(), ShaderBundleFormat::BlobAlignment);
+		}
+
+		for (size_t i = 0; i < Shaders.size(); i++)
+		{
+			const auto& blob = blobs.at(Shaders[i].Digest);
+
+			entries[i].BlobCompression = blob.BlobCompression;
+			entries[i].DataOffset = blob.Offset;
+			entries[i].DataSize = blob.GetStoredData().size();
+		}
+
+		std::ofstream f(OutputPath, std::ios::binary | std::ios::trunc);
+
+		if (!f.good())
+			return false;
+
+		auto padTo = [&](uint64_t Offset)
+		{
+			static const char zeros[ShaderBundleFormat::BlobAlignment] = {};
+			f.write(zeros, static_cast<std::streamsize>(Offset - static_cast<uint64_t>(f.tellp())));
+		};
+
+		f.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		f.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(ShaderBundleFormat::Entry));
+		f.write(names.data(), names.size());
+
+		for (const auto blob : uniqueBlobs)
+		{
+			const auto data = blob->GetStoredData();
+
+			padTo(blob->Offset);
+			f.write(reinterpret_cast<const char *>(data.data()), data.size());
+		}
+
+		padTo(dataEnd);
+
+		printf(
+			"Packed %zu shader(s), %zu unique, into %s (%llu bytes, %llu bytes uncompressed).\n",
+			Shaders.size(),
+			uniqueBlobs.size(),
+			OutputPath.string().c_str(),
+			static_cast<unsigned long long>(dataEnd),
+			static_cast<unsigned long long>(uncompressedEnd));
+
+		return f.good();
+	}
+}
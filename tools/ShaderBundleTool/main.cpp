@@ -0,0 +1,315 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "DXContainer.h"
+#include "ShaderBundleFormat.h"
+#include "ShaderBundleWriter.h"
+
+namespace ShaderBundleTool
+{
+	constexpr auto ManifestFileName = "ShaderManifest.csv";
+
+	std::string ToLowerAscii(std::string Input)
+	{
+		std::transform(
+			Input.begin(),
+			Input.end(),
+			Input.begin(),
+			[](char C)
+			{
+				return (C >= 'A' && C <= 'Z') ? static_cast<char>(C - 'A' + 'a') : C;
+			});
+
+		return Input;
+	}
+
+	std::optional<ShaderBundleFormat::Stage> ParseStage(std::string_view Prefix)
+	{
+		const auto itr = std::find(std::begin(ShaderBundleFormat::StagePrefixes), std::end(ShaderBundleFormat::StagePrefixes), Prefix);
+
+		if (itr == std::end(ShaderBundleFormat::StagePrefixes))
+			return std::nullopt;
+
+		return static_cast<ShaderBundleFormat::Stage>(std::distance(std::begin(ShaderBundleFormat::StagePrefixes), itr));
+	}
+
+	std::optional<PackedShader> ParseShaderBinFileName(const std::filesystem::path& Path, const std::string& DirectoryName)
+	{
+		// Same rules as the plugin: "<Technique>_<Id>_<Stage>.bin" inside a folder named after the technique
+		auto fileName = ToLowerAscii(Path.filename().string());
+		constexpr std::string_view extension = ".bin";
+
+		if (!fileName.ends_with(extension))
+			return std::nullopt;
+
+		fileName.resize(fileName.size() - extension.size());
+
+		const auto stageSeparator = fileName.rfind('_');
+
+		if (stageSeparator == std::string::npos || stageSeparator == 0)
+			return std::nullopt;
+
+		const auto idSeparator = fileName.rfind('_', stageSeparator - 1);
+
+		if (idSeparator == std::string::npos)
+			return std::nullopt;
+
+		PackedShader shader;
+		shader.TechniqueShortName = fileName.substr(0, idSeparator);
+		shader.Path = Path;
+
+		if (shader.TechniqueShortName != DirectoryName)
+			return std::nullopt;
+
+		const auto id = std::string_view(fileName).substr(idSeparator + 1, stageSeparator - idSeparator - 1);
+		const auto result = std::from_chars(id.data(), id.data() + id.size(), shader.TechniqueId, 16);
+
+		if (result.ec != std::errc() || result.ptr != id.data() + id.size())
+			return std::nullopt;
+
+		const auto stage = ParseStage(std::string_view(fileName).substr(stageSeparator + 1));
+
+		if (!stage)
+			return std::nullopt;
+
+		shader.Stage = *stage;
+		return shader;
+	}
+
+	bool ReadFile(const std::filesystem::path& Path, std::vector<uint8_t>& Output)
+	{
+		std::ifstream f(Path, std::ios::binary | std::ios::ate);
+
+		if (!f.good())
+			return false;
+
+		Output.resize(static_cast<size_t>(f.tellg()));
+		f.seekg(0, std::ios::beg);
+		f.read(reinterpret_cast<char *>(Output.data()), Output.size());
+
+		return f.good();
+	}
+
+	bool LoadShader(PackedShader& Shader)
+	{
+		if (!ReadFile(Shader.Path, Shader.Data) || Shader.Data.empty())
+		{
+			fprintf(stderr, "Skipping unreadable or empty file: %s\n", Shader.Path.string().c_str());
+			return false;
+		}
+
+		Shader.Digest = ShaderDigest::Compute(Shader.Data.data(), Shader.Data.size());
+		return true;
+	}
+
+	void CollectLooseShaders(const std::filesystem::path& RootDirectory, std::vector<PackedShader>& Shaders)
+	{
+		// Anything that isn't a technique folder is ignored
+		for (const auto& directory : std::filesystem::directory_iterator(RootDirectory))
+		{
+			if (!directory.is_directory())
+				continue;
+
+			const auto directoryName = ToLowerAscii(directory.path().filename().string());
+
+			for (const auto& file : std::filesystem::directory_iterator(directory.path()))
+			{
+				if (!file.is_regular_file())
+					continue;
+
+				if (auto shader = ParseShaderBinFileName(file.path(), directoryName); shader && LoadShader(*shader))
+					Shaders.emplace_back(std::move(*shader));
+			}
+		}
+	}
+
+	void CollectManifestShaders(const std::filesystem::path& RootDirectory, std::vector<PackedShader>& Shaders)
+	{
+		// Lines are "<Technique>,<Stage>,<Id>,<Digest>,<Size>,<LastWriteTime>,\"<Full technique name>\"". Only the
+		// first four fields are used. Later lines replace earlier ones.
+		std::ifstream manifest(RootDirectory / ManifestFileName);
+		std::map<std::tuple<std::string, uint64_t, ShaderBundleFormat::Stage>, size_t> keyToIndex;
+		std::string line;
+
+		while (std::getline(manifest, line))
+		{
+			std::string_view fields[4];
+			std::string_view remaining = line;
+			bool valid = true;
+
+			for (auto& field : fields)
+			{
+				const auto separator = remaining.find(',');
+
+				if (separator == std::string_view::npos)
+				{
+					valid = false;
+					break;
+				}
+
+				field = remaining.substr(0, separator);
+				remaining.remove_prefix(separator + 1);
+			}
+
+			const auto stage = valid ? ParseStage(fields[1]) : std::nullopt;
+			PackedShader shader;
+
+			if (!stage || std::from_chars(fields[2].data(), fields[2].data() + fields[2].size(), shader.TechniqueId, 16).ec != std::errc())
+			{
+				fprintf(stderr, "Skipping malformed manifest line: %s\n", line.c_str());
+				continue;
+			}
+
+			shader.TechniqueShortName = ToLowerAscii(std::string(fields[0]));
+			shader.Stage = *stage;
+			shader.Path = RootDirectory / "blobs" / (std::string(fields[3]) + ".bin");
+
+			if (!LoadShader(shader))
+				continue;
+
+			auto key = std::make_tuple(shader.TechniqueShortName, shader.TechniqueId, shader.Stage);
+
+			if (auto [itr, inserted] = keyToIndex.try_emplace(std::move(key), Shaders.size()); !inserted)
+				Shaders[itr->second] = std::move(shader);
+			else
+				Shaders.emplace_back(std::move(shader));
+		}
+	}
+
+	std::vector<PackedShader> CollectShaders(const std::filesystem::path& RootDirectory)
+	{
+		// Works on installed shadersfx trees and ShaderDumpBinPath output. Dumps are read from their blob store so that
+		// they can be packed without the loose file layout.
+		std::vector<PackedShader> shaders;
+		std::error_code ec;
+
+		if (std::filesystem::exists(RootDirectory / ManifestFileName, ec))
+			CollectManifestShaders(RootDirectory, shaders);
+		else
+			CollectLooseShaders(RootDirectory, shaders);
+
+		std::sort(
+			shaders.begin(),
+			shaders.end(),
+			[](const PackedShader& A, const PackedShader& B)
+			{
+				return std::tie(A.TechniqueShortName, A.TechniqueId, A.Stage) < std::tie(B.TechniqueShortName, B.TechniqueId, B.Stage);
+			});
+
+		return shaders;
+	}
+
+	int Pack(const std::filesystem::path& InputDirectory, const std::filesystem::path& OutputPath, bool Compress)
+	{
+		std::error_code ec;
+
+		if (!std::filesystem::is_directory(InputDirectory, ec))
+		{
+			fprintf(stderr, "Input directory doesn't exist: %s\n", InputDirectory.string().c_str());
+			return 1;
+		}
+
+		const auto shaders = CollectShaders(InputDirectory);
+
+		if (shaders.empty())
+		{
+			fprintf(stderr, "No shaders found in %s\n", InputDirectory.string().c_str());
+			return 1;
+		}
+
+		if (!WriteBundle(OutputPath, shaders, Compress))
+		{
+			fprintf(stderr, "Failed to write %s\n", OutputPath.string().c_str());
+			return 1;
+		}
+
+		return 0;
+	}
+
+	int Validate(const std::filesystem::path& ReplacementPath, const std::filesystem::path& PreviousStagePath)
+	{
+		// Runs the same checks the plugin does before handing a replacement to the driver. The previous stage is
+		// optional and checked the way the plugin links stages within one pipeline.
+		std::vector<uint8_t> replacement;
+		std::vector<uint8_t> previousStage;
+
+		if (!ReadFile(ReplacementPath, replacement) || (!PreviousStagePath.empty() && !ReadFile(PreviousStagePath, previousStage)))
+		{
+			fprintf(stderr, "Failed to read input files\n");
+			return 1;
+		}
+
+		std::string error;
+		const auto container = DXContainer::Parse(replacement, error);
+
+		if (container)
+		{
+			printf(
+				"%s: digest %s, %zu part(s):",
+				ReplacementPath.string().c_str(),
+				DXContainer::DigestToString(container->Digest).c_str(),
+				container->Parts.size());
+
+			for (const auto& part : container->Parts)
+				printf(" %.4s(%zu)", reinterpret_cast<const char *>(&part.FourCC), part.Data.size());
+
+			printf("\n");
+		}
+
+		if (!DXContainer::IsCompatibleReplacement(replacement, error))
+		{
+			printf("Incompatible: %s\n", error.c_str());
+			return 2;
+		}
+
+		if (!PreviousStagePath.empty())
+		{
+			const auto previousContainer = DXContainer::Parse(previousStage, error);
+
+			if (!previousContainer)
+			{
+				printf("Previous stage: %s\n", error.c_str());
+				return 2;
+			}
+
+			const auto inputs = DXContainer::GetInputSignature(*container);
+			const auto outputs = DXContainer::GetOutputSignature(*previousContainer);
+
+			if (inputs && outputs && !DXContainer::AreInputsProvided(*inputs, *outputs, "the previous stage", error))
+			{
+				printf("Incompatible: %s\n", error.c_str());
+				return 2;
+			}
+		}
+
+		printf("Compatible\n");
+		return 0;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	if (argc == 4 && std::string_view(argv[1]) == "pack")
+		return ShaderBundleTool::Pack(argv[2], argv[3], false);
+
+	if (argc == 5 && std::string_view(argv[1]) == "pack" && std::string_view(argv[2]) == "--compress")
+		return ShaderBundleTool::Pack(argv[3], argv[4], true);
+
+	if (argc == 3 && std::string_view(argv[1]) == "validate")
+		return ShaderBundleTool::Validate(argv[2], {});
+
+	if (argc == 4 && std::string_view(argv[1]) == "validate")
+		return ShaderBundleTool::Validate(argv[2], argv[3]);
+
+	fprintf(stderr, "Usage:\n");
+	fprintf(stderr, "  %s pack [--compress] <shadersfx or dump directory> <output%s>\n", argv[0], ShaderBundleFormat::FileExtension.data());
+	fprintf(stderr, "  %s validate <replacement.bin> [previous stage.bin]\n", argv[0]);
+	return 1;
+}